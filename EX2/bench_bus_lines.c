@@ -0,0 +1,406 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "sort_bus_lines.h"
+#include "bus_lines_compact.h"
+#include "bus_lines_derived.h"
+#include "bus_lines_index.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define MINSIZE 1000
+#define MAXSIZE 10000000
+#define SIZESTEP 10
+#define BUBBLELIMIT 10000
+#define QUICKLIMIT 10000
+#define MINWORK 1000000
+#define MINSECONDS 0.05
+#define MAXDISTANCE 1000
+#define MINDURATION 10
+#define MAXDURATION 100
+#define FEWUNIQUE 4
+#define PREFIXLENGTH 17
+#define NAMECHARS "abcdefghijklmnopqrstuvwxyz0123456789"
+#define NAMECHARSCOUNT 36
+#define NSPERSECOND 1000000000.0
+#define SEED 0x9e3779b97f4a7c15ULL
+#define BASE10 10
+
+#define CSVHEADER "generator,algorithm,key,size,ns_per_element,comparisons,moves\n"
+#define CSVFORMAT "%s,%s,%s,%zu,%.2f,%llu,%llu\n"
+#define USAGEERROR "USAGE: Ex2_bench [max_size] \n"
+#define ALLOCATIONERROR "ERROR: Out of memory \n"
+#define SORTERROR "ERROR: %s by %s did not sort the %s input \n"
+
+typedef void (*generator) (BusLine *lines, size_t n, uint64_t *state);
+typedef void (*sorter) (BusLine *start, BusLine *end, SortType sort_type);
+
+/**
+ * Input generator and the name it is reported under, with the size
+ * above which a last element pivot goes quadratic on its patterns
+ */
+typedef struct Generator
+{
+    const char *name;
+    generator fill;
+    size_t pivot_limit;
+} Generator;
+
+/**
+ * Sort path of the program, with the size above which its
+ * quadratic worst case makes timing it pointless. Paths that
+ * partition around the last element also stop at the pivot limit
+ * of the generator. Paths that sort by a derived key ignore the
+ * sort type.
+ */
+typedef struct Algorithm
+{
+    const char *name;
+    sorter sort;
+    SortType sort_type;
+    size_t limit;
+    int last_pivot;
+    const DerivedKey *derived;
+} Algorithm;
+
+static const char *const key_names[] = {"distance", "duration", "name"};
+static const DerivedKey speed = {"speed", speed_key};
+
+/**
+ * Helper function:
+ * xorshift64 random numbers, so every run sees the same inputs
+ */
+static uint64_t next_random (uint64_t *state)
+{
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+/**
+ * Helper function:
+ * a valid random name of the given length
+ */
+static void random_name (char *name, size_t length, uint64_t *state)
+{
+  for (size_t i = 0; i < length; ++i)
+  {
+    name[i] = NAMECHARS[next_random (state) % NAMECHARSCOUNT];
+  }
+  name[length] = '\0';
+}
+
+/**
+ * Helper function:
+ * line i of n lines that are ascending on every key at once
+ */
+static void ascending_line (BusLine *line, size_t i, size_t n)
+{
+  snprintf (line->name, NAME_LEN, "%09zu", i);
+  line->distance = (int) (i * (MAXDISTANCE + 1) / n);
+  line->duration = MINDURATION
+                   + (int) (i * (MAXDURATION - MINDURATION + 1) / n);
+}
+
+static void fill_random (BusLine *lines, size_t n, uint64_t *state)
+{
+  for (size_t i = 0; i < n; ++i)
+  {
+    random_name (lines[i].name, 1 + next_random (state) % (NAME_LEN - 1),
+                 state);
+    lines[i].distance = (int) (next_random (state) % (MAXDISTANCE + 1));
+    lines[i].duration = MINDURATION + (int) (next_random (state)
+                        % (MAXDURATION - MINDURATION + 1));
+  }
+}
+
+static void fill_sorted (BusLine *lines, size_t n, uint64_t *state)
+{
+  (void) state;
+  for (size_t i = 0; i < n; ++i)
+  {
+    ascending_line (lines + i, i, n);
+  }
+}
+
+static void fill_reverse (BusLine *lines, size_t n, uint64_t *state)
+{
+  (void) state;
+  for (size_t i = 0; i < n; ++i)
+  {
+    ascending_line (lines + i, n - 1 - i, n);
+  }
+}
+
+static void fill_organ_pipe (BusLine *lines, size_t n, uint64_t *state)
+{
+  (void) state;
+  for (size_t i = 0; i < n; ++i)
+  {
+    size_t rank = i < n / 2 ? 2 * i : 2 * (n - 1 - i) + 1;
+    ascending_line (lines + i, rank, n);
+  }
+}
+
+static void fill_few_unique (BusLine *lines, size_t n, uint64_t *state)
+{
+  fill_random (lines, n, state);
+  for (size_t i = 0; i < n; ++i)
+  {
+    lines[i].duration = MINDURATION + (int) (next_random (state) % FEWUNIQUE)
+                        * (MAXDURATION - MINDURATION) / (FEWUNIQUE - 1);
+  }
+}
+
+static void fill_long_prefix (BusLine *lines, size_t n, uint64_t *state)
+{
+  fill_random (lines, n, state);
+  for (size_t i = 0; i < n; ++i)
+  {
+    memset (lines[i].name, 'a', PREFIXLENGTH);
+    random_name (lines[i].name + PREFIXLENGTH, NAME_LEN - 1 - PREFIXLENGTH,
+                 state);
+  }
+}
+
+static const Generator generators[] = {
+    {"random", fill_random, MAXSIZE},
+    {"sorted", fill_sorted, QUICKLIMIT},
+    {"reverse", fill_reverse, QUICKLIMIT},
+    {"organ_pipe", fill_organ_pipe, QUICKLIMIT},
+    {"few_unique", fill_few_unique, QUICKLIMIT},
+    {"long_prefix", fill_long_prefix, MAXSIZE}};
+
+/**
+ * Helper function:
+ * bubble_sort with the signature of the other sorts, it only sorts by name
+ */
+static void bubble_by_name (BusLine *start, BusLine *end, SortType sort_type)
+{
+  (void) sort_type;
+  bubble_sort (start, end);
+}
+
+/**
+ * Helper function:
+ * lays the lines out in the order of the permutation through a copy,
+ * the way the orderings are printed. On failure the lines are left as
+ * they are, which the sortedness check reports.
+ */
+static void apply_order (BusLine *start, size_t n, const size_t *order)
+{
+  BusLine *copy = malloc (n * sizeof (BusLine));
+  if (copy == NULL)
+  {
+    return;
+  }
+  memcpy (copy, start, n * sizeof (BusLine));
+  for (size_t i = 0; i < n; ++i)
+  {
+    start[i] = copy[order[i]];
+  }
+  COUNT_MOVES (2 * n);
+  free (copy);
+}
+
+/**
+ * Helper function:
+ * build_order (counting sort of the positions) and the permutation
+ */
+static void order_sort (BusLine *start, BusLine *end, SortType sort_type)
+{
+  size_t n = (size_t) (end - start) + 1;
+  size_t *order = malloc (n * sizeof (size_t));
+  if (order != NULL && !build_order (start, n, sort_type, order))
+  {
+    apply_order (start, n, order);
+  }
+  free (order);
+}
+
+/**
+ * Helper function:
+ * build_derived_order (radix sort of the cached speeds) and the
+ * permutation, it only sorts by speed
+ */
+static void speed_sort (BusLine *start, BusLine *end, SortType sort_type)
+{
+  (void) sort_type;
+  size_t n = (size_t) (end - start) + 1;
+  size_t *order = malloc (n * sizeof (size_t));
+  if (order != NULL && !build_derived_order (start, n, speed_key, order))
+  {
+    apply_order (start, n, order);
+  }
+  free (order);
+}
+
+/**
+ * Helper function:
+ * compact_sort (counting sort of the structure-of-arrays lines),
+ * timed together with packing and unpacking the lines as the
+ * compact mode pays for them too
+ */
+static void compact_sort_lines (BusLine *start, BusLine *end,
+                                SortType sort_type)
+{
+  size_t n = (size_t) (end - start) + 1;
+  CompactLines compact;
+  if (!compact_from_lines (start, n, &compact)
+      && !compact_sort (&compact, sort_type))
+  {
+    for (size_t i = 0; i < n; ++i)
+    {
+      compact_get (&compact, i, start + i);
+    }
+  }
+  compact_free (&compact);
+}
+
+static const Algorithm algorithms[] = {
+    {"bubble_sort", bubble_by_name, NAME, BUBBLELIMIT, 0, NULL},
+    {"quick_sort", quick_sort, DISTANCE, MAXSIZE, 1, NULL},
+    {"quick_sort", quick_sort, DURATION, MAXSIZE, 1, NULL},
+    {"quick_sort", quick_sort, NAME, MAXSIZE, 1, NULL},
+    {"tim_sort", tim_sort, DISTANCE, MAXSIZE, 0, NULL},
+    {"tim_sort", tim_sort, DURATION, MAXSIZE, 0, NULL},
+    {"tim_sort", tim_sort, NAME, MAXSIZE, 0, NULL},
+    {"build_order", order_sort, DISTANCE, MAXSIZE, 0, NULL},
+    {"build_order", order_sort, DURATION, MAXSIZE, 0, NULL},
+    {"build_order", order_sort, NAME, MAXSIZE, 0, NULL},
+    {"compact_sort", compact_sort_lines, DISTANCE, MAXSIZE, 0, NULL},
+    {"compact_sort", compact_sort_lines, DURATION, MAXSIZE, 0, NULL},
+    {"compact_sort", compact_sort_lines, NAME, MAXSIZE, 0, NULL},
+    {"build_derived_order", speed_sort, DISTANCE, MAXSIZE, 0, &speed}};
+
+/**
+ * Helper function:
+ * true if the lines are in order on the key of the algorithm
+ */
+static int sorted_by (BusLine *lines, size_t n, const Algorithm *algorithm)
+{
+  for (size_t i = 1; i < n; ++i)
+  {
+    if (algorithm->derived != NULL
+        ? algorithm->derived->compute (lines + i - 1)
+          > algorithm->derived->compute (lines + i)
+        : compare (lines + i - 1, lines + i, algorithm->sort_type) > 0)
+    {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/**
+ * Helper function:
+ * name of the key the algorithm sorts by
+ */
+static const char *key_name (const Algorithm *algorithm)
+{
+  return algorithm->derived != NULL ? algorithm->derived->name
+                                    : key_names[algorithm->sort_type];
+}
+
+/**
+ * Helper function:
+ * seconds on the monotonic clock
+ */
+static double now (void)
+{
+  struct timespec time;
+  clock_gettime (CLOCK_MONOTONIC, &time);
+  return (double) time.tv_sec + (double) time.tv_nsec / NSPERSECOND;
+}
+
+/**
+ * Helper function:
+ * times the sort on fresh copies of the input, repeating small sizes
+ * until MINSECONDS or MINWORK elements have passed, and prints
+ * the averages as a CSV row
+ */
+static int bench_one (const Generator *gen, const Algorithm *algorithm,
+                      const BusLine *input, BusLine *work, size_t n)
+{
+  size_t repeats = 0;
+  double elapsed = 0;
+  unsigned long long comparisons = 0;
+  unsigned long long moves = 0;
+  while (elapsed < MINSECONDS && repeats * n < MINWORK)
+  {
+    ++repeats;
+    memcpy (work, input, n * sizeof (BusLine));
+    sort_comparisons = 0;
+    sort_moves = 0;
+    double start = now ();
+    algorithm->sort (work, work + n - 1, algorithm->sort_type);
+    elapsed += now () - start;
+    comparisons += sort_comparisons;
+    moves += sort_moves;
+  }
+  if (!sorted_by (work, n, algorithm))
+  {
+    fprintf (stderr, SORTERROR, algorithm->name, key_name (algorithm),
+             gen->name);
+    return EXIT_FAILURE;
+  }
+  printf (CSVFORMAT, gen->name, algorithm->name, key_name (algorithm), n,
+          elapsed * NSPERSECOND / (double) (repeats * n),
+          comparisons / repeats, moves / repeats);
+  fflush (stdout);
+  return EXIT_SUCCESS;
+}
+
+/**
+ * Benchmark of every sort path on every generator for sizes from
+ * MINSIZE up to max_size (default MAXSIZE) in steps of SIZESTEP.
+ * Quadratic paths stop at their limit, quick sort only on the
+ * patterned inputs.
+ */
+int main (int argc, char *argv[])
+{
+  size_t max_size = MAXSIZE;
+  if (argc > 2 || (argc == 2 && (max_size = strtoull (argv[1], NULL, BASE10))
+                                < MINSIZE))
+  {
+    printf (USAGEERROR);
+    return EXIT_FAILURE;
+  }
+  BusLine *input = malloc (max_size * sizeof (BusLine));
+  BusLine *work = malloc (max_size * sizeof (BusLine));
+  if (input == NULL || work == NULL)
+  {
+    free (input);
+    free (work);
+    printf (ALLOCATIONERROR);
+    return EXIT_FAILURE;
+  }
+
+  int result = EXIT_SUCCESS;
+  size_t generator_count = sizeof (generators) / sizeof (generators[0]);
+  size_t algorithm_count = sizeof (algorithms) / sizeof (algorithms[0]);
+  printf (CSVHEADER);
+  for (size_t n = MINSIZE; n <= max_size; n *= SIZESTEP)
+  {
+    for (size_t g = 0; g < generator_count; ++g)
+    {
+      uint64_t state = SEED;
+      generators[g].fill (input, n, &state);
+      for (size_t a = 0; a < algorithm_count; ++a)
+      {
+        if (n <= algorithms[a].limit
+            && (!algorithms[a].last_pivot || n <= generators[g].pivot_limit)
+            && bench_one (generators + g, algorithms + a, input, work, n))
+        {
+          result = EXIT_FAILURE;
+        }
+      }
+    }
+  }
+  free (input);
+  free (work);
+  return result;
+}
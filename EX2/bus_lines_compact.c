@@ -0,0 +1,340 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "bus_lines_compact.h"
+#include "bus_lines_writer.h"
+
+#include <stdlib.h>
+
+#define MINCAPACITY 64
+#define EMPTYSLOT 0
+#define KEYRANGE 65536
+
+/**
+ * Helper function:
+ * slot of the name in the pool, or the empty slot for it.
+ * Slots hold the id plus one so that zero means empty.
+ */
+static size_t find_slot (const NamePool *pool, const char *name)
+{
+  size_t mask = pool->slot_capacity - 1;
+  size_t slot = (size_t) hash_name (name) & mask;
+  while (pool->slots[slot] != EMPTYSLOT
+         && strncmp (pool->names[pool->slots[slot] - 1], name,
+                     NAME_LEN - 1) != 0)
+  {
+    slot = (slot + 1) & mask;
+  }
+  return slot;
+}
+
+/**
+ * Helper function:
+ * doubles the slots of the pool and reinserts the ids
+ */
+static int grow_slots (NamePool *pool)
+{
+  size_t capacity = pool->slot_capacity ? 2 * pool->slot_capacity
+                                        : MINCAPACITY;
+  uint32_t *slots = calloc (capacity, sizeof (uint32_t));
+  if (slots == NULL)
+  {
+    return EXIT_FAILURE;
+  }
+  free (pool->slots);
+  pool->slots = slots;
+  pool->slot_capacity = capacity;
+  for (size_t id = 0; id < pool->size; ++id)
+  {
+    pool->slots[find_slot (pool, pool->names[id])] = (uint32_t) id + 1;
+  }
+  return EXIT_SUCCESS;
+}
+
+/**
+ * Helper function:
+ * returns the id of the name, adding it to the pool if it is new
+ */
+static int intern_name (NamePool *pool, const char *name, uint32_t *id)
+{
+  if (2 * (pool->size + 1) > pool->slot_capacity && grow_slots (pool))
+  {
+    return EXIT_FAILURE;
+  }
+  size_t slot = find_slot (pool, name);
+  if (pool->slots[slot] == EMPTYSLOT)
+  {
+    if (pool->size == UINT32_MAX - 1)
+    {
+      return EXIT_FAILURE;
+    }
+    if (pool->size == pool->capacity)
+    {
+      size_t capacity = pool->capacity ? 2 * pool->capacity : MINCAPACITY;
+      char (*names)[NAME_LEN] = realloc (pool->names, capacity * NAME_LEN);
+      if (names == NULL)
+      {
+        return EXIT_FAILURE;
+      }
+      pool->names = names;
+      pool->capacity = capacity;
+    }
+    memset (pool->names[pool->size], 0, NAME_LEN);
+    memcpy (pool->names[pool->size], name, strnlen (name, NAME_LEN - 1));
+    pool->slots[slot] = (uint32_t) ++pool->size;
+  }
+  *id = pool->slots[slot] - 1;
+  return EXIT_SUCCESS;
+}
+
+/**
+ * Helper function:
+ * resizes the three line arrays
+ */
+static int reserve_lines (CompactLines *compact, size_t capacity)
+{
+  uint32_t *name_ids = realloc (compact->name_ids,
+                                capacity * sizeof (uint32_t));
+  if (name_ids != NULL)
+  {
+    compact->name_ids = name_ids;
+  }
+  uint16_t *distances = realloc (compact->distances,
+                                 capacity * sizeof (uint16_t));
+  if (distances != NULL)
+  {
+    compact->distances = distances;
+  }
+  uint16_t *durations = realloc (compact->durations,
+                                 capacity * sizeof (uint16_t));
+  if (durations != NULL)
+  {
+    compact->durations = durations;
+  }
+  if (name_ids == NULL || distances == NULL || durations == NULL)
+  {
+    return EXIT_FAILURE;
+  }
+  compact->capacity = capacity;
+  return EXIT_SUCCESS;
+}
+
+/**
+ * Init function:
+ * allocates the arrays up front when the amount of lines is known
+ */
+int compact_init (CompactLines *compact, size_t capacity)
+{
+  memset (compact, 0, sizeof (CompactLines));
+  return reserve_lines (compact, capacity < MINCAPACITY ? MINCAPACITY
+                                                        : capacity);
+}
+
+/**
+ * Append function:
+ * the distance and duration of a valid line fit 16 bits
+ */
+int compact_append (CompactLines *compact, const BusLine *line)
+{
+  if (line->distance < 0 || line->distance >= KEYRANGE
+      || line->duration < 0 || line->duration >= KEYRANGE)
+  {
+    return EXIT_FAILURE;
+  }
+  if (compact->num_lines == compact->capacity
+      && reserve_lines (compact, 2 * compact->capacity))
+  {
+    return EXIT_FAILURE;
+  }
+  uint32_t id;
+  if (intern_name (&compact->pool, line->name, &id))
+  {
+    return EXIT_FAILURE;
+  }
+  compact->name_ids[compact->num_lines] = id;
+  compact->distances[compact->num_lines] = (uint16_t) line->distance;
+  compact->durations[compact->num_lines] = (uint16_t) line->duration;
+  compact->num_lines++;
+  return EXIT_SUCCESS;
+}
+
+/**
+ * Build function:
+ * appends every line, the storage is freed on failure
+ */
+int compact_from_lines (const BusLine *lines, size_t num_lines,
+                        CompactLines *compact)
+{
+  if (compact_init (compact, num_lines))
+  {
+    compact_free (compact);
+    return EXIT_FAILURE;
+  }
+  for (size_t i = 0; i < num_lines; ++i)
+  {
+    if (compact_append (compact, lines + i))
+    {
+      compact_free (compact);
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+/**
+ * Get function:
+ * the name is copied out of the pool
+ */
+void compact_get (const CompactLines *compact, size_t i, BusLine *line)
+{
+  memcpy (line->name, compact->pool.names[compact->name_ids[i]], NAME_LEN);
+  line->distance = compact->distances[i];
+  line->duration = compact->durations[i];
+}
+
+/**
+ * Distinct name of the pool with its id, for ranking
+ */
+typedef struct RankedName
+{
+    const char *name;
+    uint32_t id;
+} RankedName;
+
+/**
+ * Helper function:
+ * qsort comparator of pool names
+ */
+static int compare_names (const void *a, const void *b)
+{
+  COUNT_COMPARISONS (1);
+  return strncmp (((const RankedName *) a)->name,
+                  ((const RankedName *) b)->name, NAME_LEN - 1);
+}
+
+/**
+ * Helper function:
+ * rank of every distinct name in alphabetical order, only the
+ * distinct names are compared
+ */
+static uint32_t *rank_names (const NamePool *pool)
+{
+  RankedName *names = malloc ((pool->size + 1) * sizeof (RankedName));
+  uint32_t *ranks = malloc ((pool->size + 1) * sizeof (uint32_t));
+  if (names == NULL || ranks == NULL)
+  {
+    free (names);
+    free (ranks);
+    return NULL;
+  }
+  for (size_t id = 0; id < pool->size; ++id)
+  {
+    names[id] = (RankedName) {pool->names[id], (uint32_t) id};
+  }
+  qsort (names, pool->size, sizeof (RankedName), compare_names);
+  for (size_t rank = 0; rank < pool->size; ++rank)
+  {
+    ranks[names[rank].id] = (uint32_t) rank;
+  }
+  free (names);
+  return ranks;
+}
+
+/**
+ * Sort function:
+ * a stable counting sort of the lines on a small integer key -
+ * the distance, the duration or the alphabetical rank of the name -
+ * scattering the three arrays into new ones, O(n + range)
+ */
+int compact_sort (CompactLines *compact, SortType sort_type)
+{
+  size_t n = compact->num_lines;
+  uint32_t *ranks = sort_type == NAME ? rank_names (&compact->pool) : NULL;
+  size_t range = sort_type == NAME ? compact->pool.size : KEYRANGE;
+  size_t *counts = calloc (range + 1, sizeof (size_t));
+  uint32_t *name_ids = malloc ((n + 1) * sizeof (uint32_t));
+  uint16_t *distances = malloc ((n + 1) * sizeof (uint16_t));
+  uint16_t *durations = malloc ((n + 1) * sizeof (uint16_t));
+  if ((sort_type == NAME && ranks == NULL) || counts == NULL
+      || name_ids == NULL || distances == NULL || durations == NULL)
+  {
+    free (ranks);
+    free (counts);
+    free (name_ids);
+    free (distances);
+    free (durations);
+    return EXIT_FAILURE;
+  }
+
+  const uint16_t *keys = sort_type == DISTANCE ? compact->distances
+                                               : compact->durations;
+  for (size_t i = 0; i < n; ++i)
+  {
+    size_t key = ranks != NULL ? ranks[compact->name_ids[i]] : keys[i];
+    counts[key + 1]++;
+  }
+  for (size_t key = 1; key <= range; ++key)
+  {
+    counts[key] += counts[key - 1];
+  }
+  for (size_t i = 0; i < n; ++i)
+  {
+    size_t key = ranks != NULL ? ranks[compact->name_ids[i]] : keys[i];
+    size_t position = counts[key]++;
+    name_ids[position] = compact->name_ids[i];
+    distances[position] = compact->distances[i];
+    durations[position] = compact->durations[i];
+  }
+  COUNT_MOVES (n);
+
+  free (compact->name_ids);
+  free (compact->distances);
+  free (compact->durations);
+  compact->name_ids = name_ids;
+  compact->distances = distances;
+  compact->durations = durations;
+  compact->capacity = n + 1;
+  free (ranks);
+  free (counts);
+  return EXIT_SUCCESS;
+}
+
+/**
+ * Write function:
+ * unpacks the lines one at a time into the buffered writer
+ */
+int compact_write (const CompactLines *compact, int fd, int binary)
+{
+  LineWriter writer;
+  if (writer_open (&writer, fd))
+  {
+    return EXIT_FAILURE;
+  }
+  for (size_t i = 0; i < compact->num_lines; ++i)
+  {
+    BusLine line;
+    compact_get (compact, i, &line);
+    if (binary)
+    {
+      writer_put_binary (&writer, &line);
+    }
+    else
+    {
+      writer_put_line (&writer, &line);
+    }
+  }
+  return writer_close (&writer);
+}
+
+/**
+ * Free function:
+ * releases the arrays and the name pool
+ */
+void compact_free (CompactLines *compact)
+{
+  free (compact->name_ids);
+  free (compact->distances);
+  free (compact->durations);
+  free (compact->pool.names);
+  free (compact->pool.slots);
+  memset (compact, 0, sizeof (CompactLines));
+}
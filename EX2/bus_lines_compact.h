@@ -0,0 +1,69 @@
+#ifndef EX2_REPO_BUSLINESCOMPACT_H
+#define EX2_REPO_BUSLINESCOMPACT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sort_bus_lines.h"
+
+/**
+ * Interned names: every distinct name is stored once and
+ * referred to by its 32-bit id
+ */
+typedef struct NamePool
+{
+    char (*names)[NAME_LEN];
+    size_t size, capacity;
+    uint32_t *slots;
+    size_t slot_capacity;
+} NamePool;
+
+/**
+ * Bus lines in structure-of-arrays layout, 8 bytes per line
+ * instead of the 32 of a BusLine
+ */
+typedef struct CompactLines
+{
+    NamePool pool;
+    uint32_t *name_ids;
+    uint16_t *distances;
+    uint16_t *durations;
+    size_t num_lines, capacity;
+} CompactLines;
+
+/**
+ * Prepare empty storage for about capacity lines
+ */
+int compact_init (CompactLines *compact, size_t capacity);
+
+/**
+ * Append a line, interning its name
+ */
+int compact_append (CompactLines *compact, const BusLine *line);
+
+/**
+ * Build the compact form of an array of lines
+ */
+int compact_from_lines (const BusLine *lines, size_t num_lines,
+                        CompactLines *compact);
+
+/**
+ * Unpack line i into a BusLine
+ */
+void compact_get (const CompactLines *compact, size_t i, BusLine *line);
+
+/**
+ * Stable sort of the lines in place by the sort type
+ */
+int compact_sort (CompactLines *compact, SortType sort_type);
+
+/**
+ * Print the lines to the file descriptor, as text or as records
+ */
+int compact_write (const CompactLines *compact, int fd, int binary);
+
+/**
+ * Free the storage
+ */
+void compact_free (CompactLines *compact);
+
+#endif //EX2_REPO_BUSLINESCOMPACT_H
@@ -0,0 +1,200 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "bus_lines_derived.h"
+#include "bus_lines_parallel.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#define RADIXBITS 16
+#define RADIXSIZE (1 << RADIXBITS)
+#define RADIXPASSES 4
+#define SIGNBIT ((uint64_t) 1 << 63)
+
+/**
+ * Cached key of a line: the derived value mapped to an unsigned
+ * word with the same order, and the position of the line
+ */
+typedef struct CachedKey
+{
+    uint64_t key;
+    size_t position;
+} CachedKey;
+
+/**
+ * Chunk of lines whose keys are computed by one thread
+ */
+typedef struct KeyJob
+{
+    LineChunk chunk;
+    const BusLine *lines;
+    CachedKey *keys;
+    derived_key compute;
+} KeyJob;
+
+static const DerivedKey derived_keys[] = {{"speed", speed_key},
+                                          {"pace", pace_key},
+                                          {NULL, NULL}};
+
+/**
+ * Derived key:
+ * distance per duration unit
+ */
+double speed_key (const BusLine *line)
+{
+  return (double) line->distance / line->duration;
+}
+
+/**
+ * Derived key:
+ * duration per distance unit (infinite for a zero distance)
+ */
+double pace_key (const BusLine *line)
+{
+  return (double) line->duration / line->distance;
+}
+
+/**
+ * Lookup function:
+ * linear search of the (short) registry
+ */
+const DerivedKey *find_derived_key (const char *name)
+{
+  for (const DerivedKey *key = derived_keys; key->name != NULL; ++key)
+  {
+    if (strcmp (key->name, name) == 0)
+    {
+      return key;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * Helper function:
+ * maps a double to an unsigned word with the same order
+ * (negative values have all bits flipped, others the sign bit set)
+ */
+static uint64_t ordered_bits (double value)
+{
+  uint64_t bits;
+  memcpy (&bits, &value, sizeof (bits));
+  return bits & SIGNBIT ? ~bits : bits | SIGNBIT;
+}
+
+/**
+ * Helper function:
+ * thread entry point, computes the keys of one chunk
+ */
+static void *compute_keys (void *arg)
+{
+  KeyJob *job = arg;
+  for (size_t i = job->chunk.first; i < job->chunk.last; ++i)
+  {
+    job->keys[i].key = ordered_bits (job->compute (job->lines + i));
+    job->keys[i].position = i;
+  }
+  return NULL;
+}
+
+/**
+ * Helper function:
+ * fills the key cache, in parallel for big arrays
+ */
+static void fill_keys (const BusLine *lines, size_t num_lines,
+                       derived_key compute, CachedKey *keys)
+{
+  KeyJob jobs[MAXTHREADS];
+  for (int t = 0; t < MAXTHREADS; ++t)
+  {
+    jobs[t] = (KeyJob) {{0, 0}, lines, keys, compute};
+  }
+  run_chunks (num_lines, sizeof (KeyJob), compute_keys, jobs);
+}
+
+/**
+ * Helper function:
+ * stable LSD radix sort of the cached keys, 16 bits per pass.
+ * Passes where every key has the same digit are skipped.
+ */
+static int radix_sort (CachedKey *keys, size_t num_lines)
+{
+  CachedKey *buffer = malloc (num_lines * sizeof (CachedKey));
+  size_t *counts = malloc (RADIXSIZE * sizeof (size_t));
+  if (buffer == NULL || counts == NULL)
+  {
+    free (buffer);
+    free (counts);
+    return EXIT_FAILURE;
+  }
+  CachedKey *from = keys;
+  CachedKey *to = buffer;
+  for (int pass = 0; pass < RADIXPASSES; ++pass)
+  {
+    int shift = pass * RADIXBITS;
+    memset (counts, 0, RADIXSIZE * sizeof (size_t));
+    for (size_t i = 0; i < num_lines; ++i)
+    {
+      counts[(from[i].key >> shift) & (RADIXSIZE - 1)]++;
+    }
+    if (counts[(from[0].key >> shift) & (RADIXSIZE - 1)] == num_lines)
+    {
+      continue;
+    }
+    size_t total = 0;
+    for (int digit = 0; digit < RADIXSIZE; ++digit)
+    {
+      size_t count = counts[digit];
+      counts[digit] = total;
+      total += count;
+    }
+    for (size_t i = 0; i < num_lines; ++i)
+    {
+      to[counts[(from[i].key >> shift) & (RADIXSIZE - 1)]++] = from[i];
+    }
+    COUNT_MOVES (num_lines);
+    CachedKey *temp = from;
+    from = to;
+    to = temp;
+  }
+  if (from != keys)
+  {
+    COUNT_MOVES (num_lines);
+    memcpy (keys, from, num_lines * sizeof (CachedKey));
+  }
+  free (buffer);
+  free (counts);
+  return EXIT_SUCCESS;
+}
+
+/**
+ * Order function:
+ * computes the derived key of every line exactly once into a cache
+ * and radix sorts the cache, so sorting does no arithmetic and no
+ * comparisons at all. Lines with equal keys keep their order.
+ */
+int build_derived_order (const BusLine *lines, size_t num_lines,
+                         derived_key key, size_t *order)
+{
+  if (num_lines == 0)
+  {
+    return EXIT_SUCCESS;
+  }
+  CachedKey *keys = malloc (num_lines * sizeof (CachedKey));
+  if (keys == NULL)
+  {
+    return EXIT_FAILURE;
+  }
+  fill_keys (lines, num_lines, key, keys);
+  if (radix_sort (keys, num_lines))
+  {
+    free (keys);
+    return EXIT_FAILURE;
+  }
+  for (size_t i = 0; i < num_lines; ++i)
+  {
+    order[i] = keys[i].position;
+  }
+  COUNT_MOVES (num_lines);
+  free (keys);
+  return EXIT_SUCCESS;
+}
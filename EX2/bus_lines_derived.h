@@ -0,0 +1,42 @@
+#ifndef EX2_REPO_BUSLINESDERIVED_H
+#define EX2_REPO_BUSLINESDERIVED_H
+
+#include <stddef.h>
+#include "sort_bus_lines.h"
+
+/**
+ * Derived key of a line, computed once per line and cached
+ */
+typedef double (*derived_key) (const BusLine *line);
+
+/**
+ * Named derived key, the sort mode is "by_" followed by the name
+ */
+typedef struct DerivedKey
+{
+    const char *name;
+    derived_key compute;
+} DerivedKey;
+
+/**
+ * Average speed, distance / duration
+ */
+double speed_key (const BusLine *line);
+
+/**
+ * Pace, duration / distance
+ */
+double pace_key (const BusLine *line);
+
+/**
+ * Find a registered derived key by name, NULL if there is none
+ */
+const DerivedKey *find_derived_key (const char *name);
+
+/**
+ * Build the order permutation of the lines by a derived key
+ */
+int build_derived_order (const BusLine *lines, size_t num_lines,
+                         derived_key key, size_t *order);
+
+#endif //EX2_REPO_BUSLINESDERIVED_H
@@ -0,0 +1,251 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "bus_lines_groups.h"
+#include "bus_lines_parallel.h"
+
+#include <stdlib.h>
+
+#define MINTABLESIZE 64
+
+/**
+ * Chunk of lines aggregated by one thread into its own table
+ */
+typedef struct GroupJob
+{
+    LineChunk chunk;
+    const BusLine *lines;
+    GroupTable table;
+    int result;
+} GroupJob;
+
+/**
+ * Helper function:
+ * finds the group of the key or the empty slot for it
+ */
+static LineGroup *find_group (const GroupTable *table, const char *key,
+                              uint64_t hash)
+{
+  size_t mask = table->capacity - 1;
+  size_t slot = (size_t) hash & mask;
+  while (table->slots[slot].used
+         && (table->slots[slot].hash != hash
+             || memcmp (table->slots[slot].name, key, NAME_LEN) != 0))
+  {
+    slot = (slot + 1) & mask;
+  }
+  return table->slots + slot;
+}
+
+/**
+ * Helper function:
+ * allocates an empty table
+ */
+static int init_table (GroupTable *table, size_t capacity)
+{
+  table->slots = calloc (capacity, sizeof (LineGroup));
+  table->capacity = capacity;
+  table->size = 0;
+  return table->slots == NULL ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/**
+ * Helper function:
+ * doubles the table and reinserts the groups
+ */
+static int grow_table (GroupTable *table)
+{
+  GroupTable bigger;
+  if (init_table (&bigger, 2 * table->capacity))
+  {
+    return EXIT_FAILURE;
+  }
+  for (size_t i = 0; i < table->capacity; ++i)
+  {
+    if (table->slots[i].used)
+    {
+      *find_group (&bigger, table->slots[i].name,
+                   table->slots[i].hash) = table->slots[i];
+    }
+  }
+  bigger.size = table->size;
+  free (table->slots);
+  *table = bigger;
+  return EXIT_SUCCESS;
+}
+
+/**
+ * Helper function:
+ * returns the group of the key, creating an empty one if needed
+ */
+static LineGroup *get_group (GroupTable *table, const char *key,
+                             uint64_t hash)
+{
+  LineGroup *group = find_group (table, key, hash);
+  if (group->used)
+  {
+    return group;
+  }
+  if (2 * (table->size + 1) > table->capacity)
+  {
+    if (grow_table (table))
+    {
+      return NULL;
+    }
+    group = find_group (table, key, hash);
+  }
+  memcpy (group->name, key, NAME_LEN);
+  group->used = 1;
+  group->hash = hash;
+  table->size++;
+  return group;
+}
+
+/**
+ * Helper function:
+ * adds the aggregates of other into group (count 0 means empty)
+ */
+static void merge_group (LineGroup *group, const LineGroup *other)
+{
+  if (group->count == 0)
+  {
+    group->first_seen = other->first_seen;
+    group->min_distance = other->min_distance;
+    group->max_distance = other->max_distance;
+    group->min_duration = other->min_duration;
+    group->max_duration = other->max_duration;
+  }
+  else
+  {
+    group->first_seen = other->first_seen < group->first_seen
+                        ? other->first_seen : group->first_seen;
+    group->min_distance = other->min_distance < group->min_distance
+                          ? other->min_distance : group->min_distance;
+    group->max_distance = other->max_distance > group->max_distance
+                          ? other->max_distance : group->max_distance;
+    group->min_duration = other->min_duration < group->min_duration
+                          ? other->min_duration : group->min_duration;
+    group->max_duration = other->max_duration > group->max_duration
+                          ? other->max_duration : group->max_duration;
+  }
+  group->count += other->count;
+  group->sum_distance += other->sum_distance;
+  group->sum_duration += other->sum_duration;
+}
+
+/**
+ * Helper function:
+ * thread entry point, aggregates one chunk into its own table
+ */
+static void *aggregate_chunk (void *arg)
+{
+  GroupJob *job = arg;
+  job->result = init_table (&job->table, MINTABLESIZE);
+  for (size_t i = job->chunk.first; job->result == EXIT_SUCCESS
+                                    && i < job->chunk.last; ++i)
+  {
+    const BusLine *line = job->lines + i;
+    char key[NAME_LEN] = {0};
+    memcpy (key, line->name, strnlen (line->name, NAME_LEN - 1));
+    LineGroup *group = get_group (&job->table, key, hash_name (key));
+    if (group == NULL)
+    {
+      job->result = EXIT_FAILURE;
+      break;
+    }
+    LineGroup single = {{0}, 1, 0, i, 1, line->distance, line->distance,
+                        line->duration, line->duration, line->distance,
+                        line->duration};
+    merge_group (group, &single);
+  }
+  return NULL;
+}
+
+/**
+ * Group function:
+ * each thread aggregates a chunk into a private table, then the
+ * partial tables are merged into the first one, all in O(n)
+ */
+int group_by_name (const BusLine *lines, size_t num_lines, GroupTable *table)
+{
+  GroupJob jobs[MAXTHREADS];
+  for (int t = 0; t < MAXTHREADS; ++t)
+  {
+    jobs[t] = (GroupJob) {{0, 0}, lines, {NULL, 0, 0}, EXIT_FAILURE};
+  }
+  size_t threads = run_chunks (num_lines, sizeof (GroupJob), aggregate_chunk,
+                               jobs);
+  int result = EXIT_SUCCESS;
+  for (size_t t = 0; t < threads; ++t)
+  {
+    result = jobs[t].result == EXIT_SUCCESS ? result : EXIT_FAILURE;
+  }
+
+  *table = jobs[0].table;
+  for (size_t t = 1; t < threads; ++t)
+  {
+    for (size_t i = 0; result == EXIT_SUCCESS
+                       && i < jobs[t].table.capacity; ++i)
+    {
+      const LineGroup *other = jobs[t].table.slots + i;
+      LineGroup *group = other->used ? get_group (table, other->name,
+                                                  other->hash) : NULL;
+      if (other->used && group == NULL)
+      {
+        result = EXIT_FAILURE;
+      }
+      else if (group != NULL)
+      {
+        merge_group (group, other);
+      }
+    }
+    free_groups (&jobs[t].table);
+  }
+  if (result != EXIT_SUCCESS)
+  {
+    free_groups (table);
+  }
+  return result;
+}
+
+/**
+ * Helper function:
+ * qsort comparator of groups by first appearance
+ */
+static int compare_first_seen (const void *a, const void *b)
+{
+  const LineGroup *first = a;
+  const LineGroup *second = b;
+  return (first->first_seen > second->first_seen)
+         - (first->first_seen < second->first_seen);
+}
+
+/**
+ * Collect function:
+ * copies the groups out of the table (table->size of them) and
+ * orders them by first appearance, so the output is deterministic
+ */
+size_t collect_groups (const GroupTable *table, LineGroup *out)
+{
+  size_t count = 0;
+  for (size_t i = 0; i < table->capacity; ++i)
+  {
+    if (table->slots[i].used)
+    {
+      out[count++] = table->slots[i];
+    }
+  }
+  qsort (out, count, sizeof (LineGroup), compare_first_seen);
+  return count;
+}
+
+/**
+ * Free function:
+ * releases the slots of the table
+ */
+void free_groups (GroupTable *table)
+{
+  free (table->slots);
+  table->slots = NULL;
+  table->capacity = 0;
+  table->size = 0;
+}
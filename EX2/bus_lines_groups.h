@@ -0,0 +1,45 @@
+#ifndef EX2_REPO_BUSLINESGROUPS_H
+#define EX2_REPO_BUSLINESGROUPS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sort_bus_lines.h"
+
+/**
+ * Aggregates of all the lines that share a name
+ */
+typedef struct LineGroup
+{
+    char name[NAME_LEN];
+    int used;
+    uint64_t hash;
+    size_t first_seen, count;
+    int min_distance, max_distance, min_duration, max_duration;
+    long long sum_distance, sum_duration;
+} LineGroup;
+
+/**
+ * Open addressing table of groups keyed by the zero padded name
+ */
+typedef struct GroupTable
+{
+    LineGroup *slots;
+    size_t capacity, size;
+} GroupTable;
+
+/**
+ * Aggregate the lines by name, with partial tables on several threads
+ */
+int group_by_name (const BusLine *lines, size_t num_lines, GroupTable *table);
+
+/**
+ * Copy the groups in order of first appearance, returns their amount
+ */
+size_t collect_groups (const GroupTable *table, LineGroup *out);
+
+/**
+ * Free the table
+ */
+void free_groups (GroupTable *table);
+
+#endif //EX2_REPO_BUSLINESGROUPS_H
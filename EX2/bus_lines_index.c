@@ -0,0 +1,299 @@
+#include "bus_lines_index.h"
+
+#include <limits.h>
+#include <stdlib.h>
+
+#define MAXCOUNTINGRANGE (1 << 20)
+#define COUNTINGSLACK 4096
+
+/**
+ * Key pair used when the keys are too spread for counting sort
+ */
+typedef struct KeyPosition
+{
+    int key;
+    size_t position;
+} KeyPosition;
+
+/**
+ * Helper function:
+ * returns the attribute of the line the sort type refers to
+ */
+static int line_key (const BusLine *line, SortType sort_type)
+{
+  return sort_type == DURATION ? line->duration : line->distance;
+}
+
+/**
+ * Helper function:
+ * qsort comparator of key pairs, ties are broken by position
+ * so the resulting order is stable
+ */
+static int compare_key_position (const void *a, const void *b)
+{
+  const KeyPosition *first = a;
+  const KeyPosition *second = b;
+  COUNT_COMPARISONS (1);
+  if (first->key != second->key)
+  {
+    return first->key < second->key ? -1 : 1;
+  }
+  return (first->position > second->position)
+         - (first->position < second->position);
+}
+
+/**
+ * Helper function:
+ * stable counting sort of the positions, used for the bounded
+ * distance and duration domains
+ */
+static int counting_order (const BusLine *lines, size_t num_lines,
+                           SortType sort_type, int min, int max,
+                           size_t *order)
+{
+  size_t range = (size_t) (max - min) + 1;
+  size_t *counts = calloc (range + 1, sizeof (size_t));
+  if (counts == NULL)
+  {
+    return EXIT_FAILURE;
+  }
+  for (size_t i = 0; i < num_lines; ++i)
+  {
+    counts[line_key (lines + i, sort_type) - min + 1]++;
+  }
+  for (size_t k = 1; k <= range; ++k)
+  {
+    counts[k] += counts[k - 1];
+  }
+  for (size_t i = 0; i < num_lines; ++i)
+  {
+    order[counts[line_key (lines + i, sort_type) - min]++] = i;
+  }
+  COUNT_MOVES (num_lines);
+  free (counts);
+  return EXIT_SUCCESS;
+}
+
+/**
+ * Helper function:
+ * comparison based fallback for keys outside of a small domain
+ */
+static int comparison_order (const BusLine *lines, size_t num_lines,
+                             SortType sort_type, size_t *order)
+{
+  KeyPosition *pairs = malloc (num_lines * sizeof (KeyPosition));
+  if (pairs == NULL)
+  {
+    return EXIT_FAILURE;
+  }
+  for (size_t i = 0; i < num_lines; ++i)
+  {
+    pairs[i].key = line_key (lines + i, sort_type);
+    pairs[i].position = i;
+  }
+  COUNT_MOVES (num_lines);
+  qsort (pairs, num_lines, sizeof (KeyPosition), compare_key_position);
+  for (size_t i = 0; i < num_lines; ++i)
+  {
+    order[i] = pairs[i].position;
+  }
+  COUNT_MOVES (num_lines);
+  free (pairs);
+  return EXIT_SUCCESS;
+}
+
+/**
+ * Helper function:
+ * stable bottom-up merge sort of the positions by name
+ */
+static int name_order (const BusLine *lines, size_t num_lines, size_t *order)
+{
+  size_t *buffer = malloc (num_lines * sizeof (size_t));
+  if (buffer == NULL)
+  {
+    return EXIT_FAILURE;
+  }
+  for (size_t i = 0; i < num_lines; ++i)
+  {
+    order[i] = i;
+  }
+  COUNT_MOVES (num_lines);
+  size_t *from = order;
+  size_t *to = buffer;
+  for (size_t width = 1; width < num_lines; width *= 2)
+  {
+    for (size_t lo = 0; lo < num_lines; lo += 2 * width)
+    {
+      size_t middle = lo + width < num_lines ? lo + width : num_lines;
+      size_t hi = middle + width < num_lines ? middle + width : num_lines;
+      size_t a = lo, b = middle, out = lo;
+      COUNT_MOVES (hi - lo);
+      while (a < middle && b < hi)
+      {
+        COUNT_COMPARISONS (1);
+        int before = strcmp (lines[from[b]].name, lines[from[a]].name) < 0;
+        to[out++] = before ? from[b++] : from[a++];
+      }
+      while (a < middle)
+      {
+        to[out++] = from[a++];
+      }
+      while (b < hi)
+      {
+        to[out++] = from[b++];
+      }
+    }
+    size_t *temp = from;
+    from = to;
+    to = temp;
+  }
+  if (from != order)
+  {
+    COUNT_MOVES (num_lines);
+    memcpy (order, from, num_lines * sizeof (size_t));
+  }
+  free (buffer);
+  return EXIT_SUCCESS;
+}
+
+/**
+ * Order function:
+ * fills order with the positions of the lines sorted by the key
+ * of the sort type. Equal keys keep their original relative order.
+ * Runs in O(n) for the bounded distance and duration domains.
+ */
+int build_order (const BusLine *lines, size_t num_lines,
+                 SortType sort_type, size_t *order)
+{
+  if (num_lines == 0)
+  {
+    return EXIT_SUCCESS;
+  }
+  if (sort_type == NAME)
+  {
+    return name_order (lines, num_lines, order);
+  }
+  int min = line_key (lines, sort_type);
+  int max = min;
+  for (size_t i = 1; i < num_lines; ++i)
+  {
+    int key = line_key (lines + i, sort_type);
+    min = key < min ? key : min;
+    max = key > max ? key : max;
+  }
+  long range = (long) max - (long) min;
+  if (range < MAXCOUNTINGRANGE
+      && (size_t) range <= 2 * num_lines + COUNTINGSLACK)
+  {
+    return counting_order (lines, num_lines, sort_type, min, max, order);
+  }
+  return comparison_order (lines, num_lines, sort_type, order);
+}
+
+/**
+ * Index function:
+ * builds the sorted key arrays of every indexed attribute once,
+ * so later queries are answered by binary search
+ */
+int build_index (BusLineIndex *index, const BusLine *lines, size_t num_lines)
+{
+  index->lines = lines;
+  index->num_lines = num_lines;
+  for (int type = 0; type < INDEXED_ATTRIBUTES; ++type)
+  {
+    index->attributes[type].keys = NULL;
+    index->attributes[type].order = NULL;
+  }
+  for (int type = 0; type < INDEXED_ATTRIBUTES; ++type)
+  {
+    SortedKeys *sorted = index->attributes + type;
+    sorted->keys = malloc ((num_lines + 1) * sizeof (int));
+    sorted->order = malloc ((num_lines + 1) * sizeof (size_t));
+    if (sorted->keys == NULL || sorted->order == NULL
+        || build_order (lines, num_lines, type, sorted->order))
+    {
+      free_index (index);
+      return EXIT_FAILURE;
+    }
+    for (size_t i = 0; i < num_lines; ++i)
+    {
+      sorted->keys[i] = line_key (lines + sorted->order[i], type);
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+/**
+ * Free function:
+ * releases the sorted key arrays, the lines are left untouched
+ */
+void free_index (BusLineIndex *index)
+{
+  for (int type = 0; type < INDEXED_ATTRIBUTES; ++type)
+  {
+    free (index->attributes[type].keys);
+    index->attributes[type].keys = NULL;
+    free (index->attributes[type].order);
+    index->attributes[type].order = NULL;
+  }
+  index->num_lines = 0;
+}
+
+/**
+ * Helper function:
+ * binary search for the first slot whose key is >= bound
+ */
+static size_t lower_bound (const int *keys, size_t size, int bound)
+{
+  size_t low = 0;
+  size_t high = size;
+  while (low < high)
+  {
+    size_t middle = low + (high - low) / 2;
+    if (keys[middle] < bound)
+    {
+      low = middle + 1;
+    }
+    else
+    {
+      high = middle;
+    }
+  }
+  return low;
+}
+
+/**
+ * Range function:
+ * returns the amount of lines with low <= key <= high in O(log n).
+ * If positions is not NULL it is set to the first of the matching
+ * positions in the lines array, which are contiguous and sorted by key.
+ */
+size_t index_range (const BusLineIndex *index, SortType sort_type,
+                    int low, int high, const size_t **positions)
+{
+  const SortedKeys *sorted = index->attributes + sort_type;
+  size_t first = lower_bound (sorted->keys, index->num_lines, low);
+  size_t last = first;
+  if (high >= low)
+  {
+    last = high == INT_MAX ? index->num_lines
+                           : lower_bound (sorted->keys, index->num_lines,
+                                          high + 1);
+  }
+  if (positions != NULL)
+  {
+    *positions = sorted->order + first;
+  }
+  return last > first ? last - first : 0;
+}
+
+/**
+ * Count function:
+ * returns the amount of lines with key < bound in O(log n)
+ */
+size_t index_count_below (const BusLineIndex *index, SortType sort_type,
+                          int bound)
+{
+  return lower_bound (index->attributes[sort_type].keys,
+                      index->num_lines, bound);
+}
@@ -0,0 +1,59 @@
+#ifndef EX2_REPO_BUSLINESINDEX_H
+#define EX2_REPO_BUSLINESINDEX_H
+
+#include <stddef.h>
+#include "sort_bus_lines.h"
+
+#define INDEXED_ATTRIBUTES 2
+
+/**
+ * Sorted keys of one attribute:
+ * keys[i] is the i-th smallest key and order[i] is the position
+ * of the line holding it in the indexed array
+ */
+typedef struct SortedKeys
+{
+    int *keys;
+    size_t *order;
+} SortedKeys;
+
+/**
+ * Index over an array of bus lines, one sorted key array per SortType.
+ * The lines are not copied and must outlive the index.
+ */
+typedef struct BusLineIndex
+{
+    const BusLine *lines;
+    size_t num_lines;
+    SortedKeys attributes[INDEXED_ATTRIBUTES];
+} BusLineIndex;
+
+/**
+ * Build the order permutation of the lines by the given sort type
+ */
+int build_order (const BusLine *lines, size_t num_lines,
+                 SortType sort_type, size_t *order);
+
+/**
+ * Build the index over the lines
+ */
+int build_index (BusLineIndex *index, const BusLine *lines, size_t num_lines);
+
+/**
+ * Free the index arrays
+ */
+void free_index (BusLineIndex *index);
+
+/**
+ * Range query: lines with low <= key <= high
+ */
+size_t index_range (const BusLineIndex *index, SortType sort_type,
+                    int low, int high, const size_t **positions);
+
+/**
+ * Count query: lines with key < bound
+ */
+size_t index_count_below (const BusLineIndex *index, SortType sort_type,
+                          int bound);
+
+#endif //EX2_REPO_BUSLINESINDEX_H
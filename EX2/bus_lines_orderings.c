@@ -0,0 +1,136 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "bus_lines_orderings.h"
+#include "bus_lines_index.h"
+#include "bus_lines_writer.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define FILEMODE 0644
+#define MAXPATH 4096
+#define CSVEXTENSION ".csv"
+#define BINARYEXTENSION ".bin"
+
+static const char *const ordering_names[ORDERINGS] = {"by_distance",
+                                                      "by_duration",
+                                                      "by_name"};
+
+/**
+ * Work of one ordering thread. All threads share the same
+ * immutable lines and only own their permutation.
+ */
+typedef struct OrderingJob
+{
+    const BusLine *lines;
+    size_t num_lines;
+    SortType sort_type;
+    int binary;
+    char path[MAXPATH];
+    int result;
+} OrderingJob;
+
+/**
+ * Helper function:
+ * writes the lines in the order of the permutation to the file
+ */
+static int write_ordering (const OrderingJob *job, const size_t *order)
+{
+  int fd = open (job->path, O_WRONLY | O_CREAT | O_TRUNC, FILEMODE);
+  if (fd < 0)
+  {
+    return EXIT_FAILURE;
+  }
+  LineWriter writer;
+  if (writer_open (&writer, fd))
+  {
+    close (fd);
+    return EXIT_FAILURE;
+  }
+  for (size_t i = 0; i < job->num_lines; ++i)
+  {
+    if (job->binary)
+    {
+      writer_put_binary (&writer, job->lines + order[i]);
+    }
+    else
+    {
+      writer_put_line (&writer, job->lines + order[i]);
+    }
+  }
+  int result = writer_close (&writer);
+  if (close (fd) != 0)
+  {
+    result = EXIT_FAILURE;
+  }
+  return result;
+}
+
+/**
+ * Helper function:
+ * thread entry point, builds one index permutation and writes it
+ */
+static void *run_ordering (void *arg)
+{
+  OrderingJob *job = arg;
+  size_t *order = malloc ((job->num_lines + 1) * sizeof (size_t));
+  job->result = EXIT_FAILURE;
+  if (order != NULL
+      && build_order (job->lines, job->num_lines, job->sort_type,
+                      order) == EXIT_SUCCESS)
+  {
+    job->result = write_ordering (job, order);
+  }
+  free (order);
+  return NULL;
+}
+
+/**
+ * Orderings function:
+ * one thread per ordering builds a permutation of the shared lines
+ * (no copies of the lines are made) and writes its own output file,
+ * so the three sorts and the three writes all run in parallel
+ */
+int write_all_orderings (const BusLine *lines, size_t num_lines,
+                         const char *prefix, int binary)
+{
+  OrderingJob jobs[ORDERINGS];
+  pthread_t threads[ORDERINGS];
+  int started[ORDERINGS] = {0};
+  int result = EXIT_SUCCESS;
+
+  for (int type = 0; type < ORDERINGS; ++type)
+  {
+    jobs[type] = (OrderingJob) {lines, num_lines, (SortType) type, binary,
+                                {0}, EXIT_FAILURE};
+    int length = snprintf (jobs[type].path, MAXPATH, "%s%s%s", prefix,
+                           ordering_names[type],
+                           binary ? BINARYEXTENSION : CSVEXTENSION);
+    if (length < 0 || length >= MAXPATH)
+    {
+      result = EXIT_FAILURE;
+      continue;
+    }
+    started[type] = pthread_create (threads + type, NULL, run_ordering,
+                                    jobs + type) == 0;
+    if (!started[type])
+    {
+      run_ordering (jobs + type);
+    }
+  }
+  for (int type = 0; type < ORDERINGS; ++type)
+  {
+    if (started[type])
+    {
+      pthread_join (threads[type], NULL);
+    }
+    if (jobs[type].result != EXIT_SUCCESS)
+    {
+      result = EXIT_FAILURE;
+    }
+  }
+  return result;
+}
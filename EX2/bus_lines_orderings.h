@@ -0,0 +1,17 @@
+#ifndef EX2_REPO_BUSLINESORDERINGS_H
+#define EX2_REPO_BUSLINESORDERINGS_H
+
+#include <stddef.h>
+#include "sort_bus_lines.h"
+
+#define ORDERINGS 3
+
+/**
+ * Build the distance, duration and name orderings concurrently
+ * and write each one to prefix + by_<order>.csv, or to
+ * prefix + by_<order>.bin for binary records
+ */
+int write_all_orderings (const BusLine *lines, size_t num_lines,
+                         const char *prefix, int binary);
+
+#endif //EX2_REPO_BUSLINESORDERINGS_H
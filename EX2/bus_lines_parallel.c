@@ -0,0 +1,46 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "bus_lines_parallel.h"
+
+#include <pthread.h>
+#include <unistd.h>
+
+/**
+ * Parallel function:
+ * splits the items into one chunk per online processor (at most
+ * MAXTHREADS, a single chunk below PARALLELTHRESHOLD items), sets the
+ * LineChunk of job t to chunk t and runs every job on its own thread.
+ * jobs is an array of MAXTHREADS jobs of job_size bytes. A job whose
+ * thread can not be started runs on the calling thread.
+ * Returns the amount of jobs used, once all of them are done.
+ */
+size_t run_chunks (size_t num_items, size_t job_size, chunk_job run,
+                   void *jobs)
+{
+  long threads = sysconf (_SC_NPROCESSORS_ONLN);
+  threads = threads > MAXTHREADS ? MAXTHREADS : threads;
+  threads = num_items < PARALLELTHRESHOLD || threads < 1 ? 1 : threads;
+  pthread_t ids[MAXTHREADS];
+  int started[MAXTHREADS] = {0};
+  size_t step = num_items / (size_t) threads;
+  for (long t = 0; t < threads; ++t)
+  {
+    void *job = (char *) jobs + (size_t) t * job_size;
+    LineChunk *chunk = job;
+    chunk->first = (size_t) t * step;
+    chunk->last = t == threads - 1 ? num_items : chunk->first + step;
+    started[t] = threads > 1 && pthread_create (ids + t, NULL, run, job) == 0;
+    if (!started[t])
+    {
+      run (job);
+    }
+  }
+  for (long t = 0; t < threads; ++t)
+  {
+    if (started[t])
+    {
+      pthread_join (ids[t], NULL);
+    }
+  }
+  return (size_t) threads;
+}
@@ -0,0 +1,29 @@
+#ifndef EX2_REPO_BUSLINESPARALLEL_H
+#define EX2_REPO_BUSLINESPARALLEL_H
+
+#include <stddef.h>
+
+#define MAXTHREADS 16
+#define PARALLELTHRESHOLD (1 << 16)
+
+/**
+ * Range [first, last) of the items handed to one job,
+ * the first member of every job passed to run_chunks
+ */
+typedef struct LineChunk
+{
+    size_t first, last;
+} LineChunk;
+
+/**
+ * Thread entry point that processes one job
+ */
+typedef void *(*chunk_job) (void *job);
+
+/**
+ * Split num_items items into one chunk per processor and run the jobs
+ */
+size_t run_chunks (size_t num_items, size_t job_size, chunk_job run,
+                   void *jobs);
+
+#endif //EX2_REPO_BUSLINESPARALLEL_H
@@ -0,0 +1,232 @@
+#include "bus_lines_skiplist.h"
+
+#include <stdlib.h>
+
+#define SKIPLIST_SEED 0x9e3779b97f4a7c15ULL
+#define LEVELBITS 2
+#define LEVELMASK 3u
+
+/**
+ * Helper function:
+ * total order of the lines: the key of the sort type first,
+ * then name, distance and duration
+ */
+static int record_compare (const BusLine *a, const BusLine *b,
+                           SortType sort_type)
+{
+  int result = compare ((BusLine *) a, (BusLine *) b, sort_type);
+  if (result != 0)
+  {
+    return result;
+  }
+  result = strcmp (a->name, b->name);
+  if (result != 0)
+  {
+    return result;
+  }
+  if (a->distance != b->distance)
+  {
+    return a->distance < b->distance ? -1 : 1;
+  }
+  return (a->duration > b->duration) - (a->duration < b->duration);
+}
+
+/**
+ * Helper function:
+ * allocates a node with level forward pointers
+ */
+static SkipNode *create_node (int level)
+{
+  SkipNode *node = calloc (1, sizeof (SkipNode)
+                              + (size_t) level * sizeof (SkipNode *));
+  if (node != NULL)
+  {
+    node->level = level;
+  }
+  return node;
+}
+
+/**
+ * Helper function:
+ * random level with P(level > k) = 4^-k, from a xorshift generator
+ * owned by the list (so rand() sequences of the caller are untouched)
+ */
+static int random_level (BusLineSkipList *list)
+{
+  list->seed ^= list->seed << 13;
+  list->seed ^= list->seed >> 7;
+  list->seed ^= list->seed << 17;
+  uint64_t bits = list->seed;
+  int level = 1;
+  while (level < SKIPLIST_MAX_LEVEL && (bits & LEVELMASK) == 0)
+  {
+    ++level;
+    bits >>= LEVELBITS;
+  }
+  return level;
+}
+
+/**
+ * Helper function:
+ * fills update[i] with the last node on level i that is placed
+ * before the line (or not after it if after_equal is set)
+ */
+static void find_path (const BusLineSkipList *list, const BusLine *line,
+                       int after_equal, SkipNode **update)
+{
+  SkipNode *current = list->head;
+  for (int i = list->level - 1; i >= 0; --i)
+  {
+    while (current->next[i] != NULL)
+    {
+      int result = record_compare (&current->next[i]->line, line,
+                                   list->sort_type);
+      if (result > 0 || (result == 0 && !after_equal))
+      {
+        break;
+      }
+      current = current->next[i];
+    }
+    update[i] = current;
+  }
+}
+
+/**
+ * Init function:
+ * creates the head sentinel of an empty list
+ */
+int skiplist_init (BusLineSkipList *list, SortType sort_type)
+{
+  list->sort_type = sort_type;
+  list->size = 0;
+  list->level = 1;
+  list->seed = SKIPLIST_SEED;
+  list->head = create_node (SKIPLIST_MAX_LEVEL);
+  return list->head == NULL ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/**
+ * Free function:
+ * walks the bottom level and frees every node
+ */
+void skiplist_free (BusLineSkipList *list)
+{
+  SkipNode *current = list->head;
+  while (current != NULL)
+  {
+    SkipNode *next = current->next[0];
+    free (current);
+    current = next;
+  }
+  list->head = NULL;
+  list->size = 0;
+}
+
+/**
+ * Insert function:
+ * links a copy of the line after all the equal lines already stored,
+ * so lines that arrive later come later in the order
+ */
+int skiplist_insert (BusLineSkipList *list, const BusLine *line)
+{
+  SkipNode *update[SKIPLIST_MAX_LEVEL];
+  find_path (list, line, 1, update);
+  int level = random_level (list);
+  SkipNode *node = create_node (level);
+  if (node == NULL)
+  {
+    return EXIT_FAILURE;
+  }
+  node->line = *line;
+  for (int i = list->level; i < level; ++i)
+  {
+    update[i] = list->head;
+  }
+  list->level = level > list->level ? level : list->level;
+  for (int i = 0; i < level; ++i)
+  {
+    node->next[i] = update[i]->next[i];
+    update[i]->next[i] = node;
+  }
+  list->size++;
+  return EXIT_SUCCESS;
+}
+
+/**
+ * Remove function:
+ * unlinks the first line equal to the given one,
+ * returns EXIT_FAILURE if there is no such line
+ */
+int skiplist_remove (BusLineSkipList *list, const BusLine *line)
+{
+  SkipNode *update[SKIPLIST_MAX_LEVEL];
+  find_path (list, line, 0, update);
+  SkipNode *node = update[0]->next[0];
+  if (node == NULL || record_compare (&node->line, line, list->sort_type))
+  {
+    return EXIT_FAILURE;
+  }
+  for (int i = 0; i < node->level; ++i)
+  {
+    if (update[i]->next[i] == node)
+    {
+      update[i]->next[i] = node->next[i];
+    }
+  }
+  free (node);
+  while (list->level > 1 && list->head->next[list->level - 1] == NULL)
+  {
+    list->level--;
+  }
+  list->size--;
+  return EXIT_SUCCESS;
+}
+
+/**
+ * Update function:
+ * a changed line moves to its new position, so this is
+ * a remove followed by an insert
+ */
+int skiplist_update (BusLineSkipList *list, const BusLine *old_line,
+                     const BusLine *new_line)
+{
+  if (skiplist_remove (list, old_line))
+  {
+    return EXIT_FAILURE;
+  }
+  return skiplist_insert (list, new_line);
+}
+
+/**
+ * Iteration function:
+ * first line in order
+ */
+const SkipNode *skiplist_first (const BusLineSkipList *list)
+{
+  return list->head->next[0];
+}
+
+/**
+ * Iteration function:
+ * line following the node in order
+ */
+const SkipNode *skiplist_next (const SkipNode *node)
+{
+  return node->next[0];
+}
+
+/**
+ * Copy function:
+ * writes the sorted lines into out in O(n), e.g. to publish
+ * a presorted snapshot without sorting again
+ */
+size_t skiplist_copy (const BusLineSkipList *list, BusLine *out)
+{
+  size_t count = 0;
+  for (const SkipNode *node = skiplist_first (list); node != NULL;
+       node = skiplist_next (node))
+  {
+    out[count++] = node->line;
+  }
+  return count;
+}
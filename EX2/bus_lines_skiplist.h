@@ -0,0 +1,75 @@
+#ifndef EX2_REPO_BUSLINESSKIPLIST_H
+#define EX2_REPO_BUSLINESSKIPLIST_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sort_bus_lines.h"
+
+#define SKIPLIST_MAX_LEVEL 24
+
+/**
+ * Node of the skip list, next[i] is the following node on level i
+ */
+typedef struct SkipNode
+{
+    BusLine line;
+    int level;
+    struct SkipNode *next[];
+} SkipNode;
+
+/**
+ * Ordered container of bus lines for one SortType.
+ * Lines with equal keys are ordered by name, distance and duration,
+ * so every line has a well defined position.
+ */
+typedef struct BusLineSkipList
+{
+    SortType sort_type;
+    SkipNode *head;
+    size_t size;
+    int level;
+    uint64_t seed;
+} BusLineSkipList;
+
+/**
+ * Create an empty list ordered by the sort type
+ */
+int skiplist_init (BusLineSkipList *list, SortType sort_type);
+
+/**
+ * Free all the nodes of the list
+ */
+void skiplist_free (BusLineSkipList *list);
+
+/**
+ * Insert a copy of the line in O(log n)
+ */
+int skiplist_insert (BusLineSkipList *list, const BusLine *line);
+
+/**
+ * Remove one line equal to the given one in O(log n)
+ */
+int skiplist_remove (BusLineSkipList *list, const BusLine *line);
+
+/**
+ * Replace a line by its updated version in O(log n)
+ */
+int skiplist_update (BusLineSkipList *list, const BusLine *old_line,
+                     const BusLine *new_line);
+
+/**
+ * First node in order, NULL if the list is empty
+ */
+const SkipNode *skiplist_first (const BusLineSkipList *list);
+
+/**
+ * Following node in order, NULL at the end
+ */
+const SkipNode *skiplist_next (const SkipNode *node);
+
+/**
+ * Copy the lines in order into out (size lines)
+ */
+size_t skiplist_copy (const BusLineSkipList *list, BusLine *out);
+
+#endif //EX2_REPO_BUSLINESSKIPLIST_H
@@ -0,0 +1,157 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "bus_lines_snapshot.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define WRITEMODE "wb"
+#define RECORDSPERBLOCK 4096
+#define MAXDISTANCE 1000
+#define MINDURATION 10
+#define MAXDURATION 100
+
+/**
+ * Write function:
+ * writes the header and then the lines as fixed-size records.
+ * The records are copied through a zeroed block so the padding
+ * bytes of the file are deterministic. A file that could not be
+ * written completely is removed.
+ */
+int write_snapshot (const char *path, const BusLine *lines, size_t num_lines,
+                    uint32_t presorted)
+{
+  FILE *file = fopen (path, WRITEMODE);
+  if (file == NULL)
+  {
+    return EXIT_FAILURE;
+  }
+  SnapshotHeader header = {SNAPSHOT_MAGIC, SNAPSHOT_VERSION,
+                           sizeof (BusLine), presorted, num_lines, 0};
+  BusLine *block = malloc (RECORDSPERBLOCK * sizeof (BusLine));
+  int result = block != NULL
+               && fwrite (&header, sizeof (header), 1, file) == 1
+               ? EXIT_SUCCESS : EXIT_FAILURE;
+
+  for (size_t done = 0; result == EXIT_SUCCESS && done < num_lines;)
+  {
+    size_t count = num_lines - done;
+    count = count < RECORDSPERBLOCK ? count : RECORDSPERBLOCK;
+    memset (block, 0, count * sizeof (BusLine));
+    for (size_t i = 0; i < count; ++i)
+    {
+      strncpy (block[i].name, lines[done + i].name, NAME_LEN - 1);
+      block[i].distance = lines[done + i].distance;
+      block[i].duration = lines[done + i].duration;
+    }
+    if (fwrite (block, sizeof (BusLine), count, file) != count)
+    {
+      result = EXIT_FAILURE;
+    }
+    done += count;
+  }
+
+  free (block);
+  if (fclose (file) != 0)
+  {
+    result = EXIT_FAILURE;
+  }
+  if (result != EXIT_SUCCESS)
+  {
+    remove (path);
+  }
+  return result;
+}
+
+/**
+ * Helper function:
+ * true if every record holds a NUL terminated name and keys
+ * in the ranges the input accepts, checked in one pass
+ */
+static int records_valid (const BusLine *lines, size_t num_lines)
+{
+  for (size_t i = 0; i < num_lines; ++i)
+  {
+    if (memchr (lines[i].name, '\0', NAME_LEN) == NULL
+        || lines[i].distance < 0 || lines[i].distance > MAXDISTANCE
+        || lines[i].duration < MINDURATION
+        || lines[i].duration > MAXDURATION)
+    {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/**
+ * Open function:
+ * maps the whole file at once and validates the header and
+ * every record. Returns SNAPSHOT_MISSING if there is no such
+ * file, and SNAPSHOT_INVALID if it is not a snapshot of this
+ * version, holds more lines than an int can count or holds a
+ * record the input would not accept.
+ */
+int open_snapshot (const char *path, BusLineSnapshot *snapshot)
+{
+  int fd = open (path, O_RDONLY);
+  if (fd < 0)
+  {
+    return errno == ENOENT ? SNAPSHOT_MISSING : SNAPSHOT_INVALID;
+  }
+  struct stat info;
+  if (fstat (fd, &info) != 0
+      || (size_t) info.st_size < sizeof (SnapshotHeader))
+  {
+    close (fd);
+    return SNAPSHOT_INVALID;
+  }
+  size_t size = (size_t) info.st_size;
+  void *mapping = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                        fd, 0);
+  close (fd);
+  if (mapping == MAP_FAILED)
+  {
+    return SNAPSHOT_INVALID;
+  }
+
+  const SnapshotHeader *header = mapping;
+  if (header->magic != SNAPSHOT_MAGIC || header->version != SNAPSHOT_VERSION
+      || header->record_size != sizeof (BusLine)
+      || header->count > (size - sizeof (SnapshotHeader)) / sizeof (BusLine)
+      || header->count > INT_MAX
+      || !records_valid ((const BusLine *) ((char *) mapping
+                                            + sizeof (SnapshotHeader)),
+                         (size_t) header->count))
+  {
+    munmap (mapping, size);
+    return SNAPSHOT_INVALID;
+  }
+
+  snapshot->mapping = mapping;
+  snapshot->mapping_size = size;
+  snapshot->lines = (BusLine *) ((char *) mapping + sizeof (SnapshotHeader));
+  snapshot->num_lines = (size_t) header->count;
+  snapshot->presorted = header->presorted;
+  return SNAPSHOT_OK;
+}
+
+/**
+ * Close function:
+ * releases the mapping, the lines may not be used afterwards
+ */
+void close_snapshot (BusLineSnapshot *snapshot)
+{
+  if (snapshot->mapping != NULL)
+  {
+    munmap (snapshot->mapping, snapshot->mapping_size);
+  }
+  snapshot->mapping = NULL;
+  snapshot->lines = NULL;
+  snapshot->num_lines = 0;
+}
@@ -0,0 +1,62 @@
+#ifndef EX2_REPO_BUSLINESSNAPSHOT_H
+#define EX2_REPO_BUSLINESSNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sort_bus_lines.h"
+
+#define SNAPSHOT_MAGIC 0x4c425845u
+#define SNAPSHOT_VERSION 1
+
+#define SNAPSHOT_OK 0
+#define SNAPSHOT_MISSING 1
+#define SNAPSHOT_INVALID 2
+
+/**
+ * Presorted flags, one bit per SortType
+ */
+#define SNAPSHOT_SORTED(sort_type) (1u << (sort_type))
+
+/**
+ * On-disk header, followed by count fixed-size BusLine records
+ */
+typedef struct SnapshotHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t presorted;
+    uint64_t count;
+    uint64_t reserved;
+} SnapshotHeader;
+
+/**
+ * A snapshot mapped into memory. The mapping is private, so the lines
+ * can be sorted in place without touching the file.
+ */
+typedef struct BusLineSnapshot
+{
+    void *mapping;
+    size_t mapping_size;
+    BusLine *lines;
+    size_t num_lines;
+    uint32_t presorted;
+} BusLineSnapshot;
+
+/**
+ * Write the lines to a snapshot file
+ */
+int write_snapshot (const char *path, const BusLine *lines, size_t num_lines,
+                    uint32_t presorted);
+
+/**
+ * Map a snapshot file with a single mmap
+ */
+int open_snapshot (const char *path, BusLineSnapshot *snapshot);
+
+/**
+ * Unmap a snapshot
+ */
+void close_snapshot (BusLineSnapshot *snapshot);
+
+#endif //EX2_REPO_BUSLINESSNAPSHOT_H
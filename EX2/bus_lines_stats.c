@@ -0,0 +1,223 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "bus_lines_stats.h"
+#include "bus_lines_parallel.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+/**
+ * Partial summary of one chunk of lines
+ */
+typedef struct SummaryJob
+{
+    LineChunk chunk;
+    const BusLine *lines;
+    BusLineSummary summary;
+} SummaryJob;
+
+/**
+ * Helper function:
+ * empties a histogram over [min, max]
+ */
+static void histogram_init (Histogram *histogram, int min, int max)
+{
+  memset (histogram, 0, sizeof (Histogram));
+  histogram->min = min;
+  histogram->max = max;
+}
+
+/**
+ * Helper function:
+ * counts one value, clamped into the domain
+ */
+static void histogram_add (Histogram *histogram, int value)
+{
+  value = value < histogram->min ? histogram->min : value;
+  value = value > histogram->max ? histogram->max : value;
+  histogram->buckets[value - histogram->min]++;
+  histogram->count++;
+}
+
+/**
+ * Helper function:
+ * log base of the sketch buckets, gamma = (1 + a) / (1 - a)
+ */
+static double sketch_gamma (void)
+{
+  return (1 + SKETCH_ACCURACY) / (1 - SKETCH_ACCURACY);
+}
+
+/**
+ * Helper function:
+ * counts one value in the bucket ceil(log_gamma (value))
+ */
+static void sketch_add (QuantileSketch *sketch, double value)
+{
+  sketch->count++;
+  if (value <= 0)
+  {
+    sketch->zero_count++;
+    return;
+  }
+  long index = (long) ceil (log (value) / log (sketch_gamma ()))
+               + SKETCH_OFFSET;
+  index = index < 0 ? 0 : index;
+  index = index >= SKETCH_BUCKETS ? SKETCH_BUCKETS - 1 : index;
+  sketch->buckets[index]++;
+}
+
+/**
+ * Helper function:
+ * rank of the q quantile, the smallest rank covering q of the values
+ */
+static size_t quantile_rank (size_t count, double q)
+{
+  q = q < 0 ? 0 : (q > 1 ? 1 : q);
+  size_t rank = (size_t) ceil (q * (double) count);
+  return rank == 0 ? 1 : rank;
+}
+
+/**
+ * Init function:
+ * empty histograms over the valid domains and an empty sketch
+ */
+void summary_init (BusLineSummary *summary)
+{
+  histogram_init (&summary->distance, STATS_MIN_DISTANCE, STATS_MAX_DISTANCE);
+  histogram_init (&summary->duration, STATS_MIN_DURATION, STATS_MAX_DURATION);
+  memset (&summary->speed, 0, sizeof (QuantileSketch));
+}
+
+/**
+ * Add function:
+ * O(1) update of every part of the summary
+ */
+void summary_add (BusLineSummary *summary, const BusLine *line)
+{
+  histogram_add (&summary->distance, line->distance);
+  histogram_add (&summary->duration, line->duration);
+  sketch_add (&summary->speed, line->duration > 0
+                               ? (double) line->distance / line->duration
+                               : 0);
+}
+
+/**
+ * Merge function:
+ * histograms and sketches merge by adding their buckets,
+ * so the merged summary equals the summary of all the lines
+ */
+void summary_merge (BusLineSummary *summary, const BusLineSummary *other)
+{
+  for (int i = 0; i <= STATS_MAX_DISTANCE - STATS_MIN_DISTANCE; ++i)
+  {
+    summary->distance.buckets[i] += other->distance.buckets[i];
+  }
+  for (int i = 0; i <= STATS_MAX_DURATION - STATS_MIN_DURATION; ++i)
+  {
+    summary->duration.buckets[i] += other->duration.buckets[i];
+  }
+  for (int i = 0; i < SKETCH_BUCKETS; ++i)
+  {
+    summary->speed.buckets[i] += other->speed.buckets[i];
+  }
+  summary->distance.count += other->distance.count;
+  summary->duration.count += other->duration.count;
+  summary->speed.count += other->speed.count;
+  summary->speed.zero_count += other->speed.zero_count;
+}
+
+/**
+ * Helper function:
+ * thread entry point, summarizes one chunk
+ */
+static void *summarize_chunk (void *arg)
+{
+  SummaryJob *job = arg;
+  summary_init (&job->summary);
+  for (size_t i = job->chunk.first; i < job->chunk.last; ++i)
+  {
+    summary_add (&job->summary, job->lines + i);
+  }
+  return NULL;
+}
+
+/**
+ * Summary function:
+ * one pass over the lines, split into chunks whose partial summaries
+ * are built in parallel and merged, no sorting involved
+ */
+int summarize_lines (const BusLine *lines, size_t num_lines,
+                     BusLineSummary *summary)
+{
+  SummaryJob *jobs = malloc (MAXTHREADS * sizeof (SummaryJob));
+  if (jobs == NULL)
+  {
+    return EXIT_FAILURE;
+  }
+  for (int t = 0; t < MAXTHREADS; ++t)
+  {
+    jobs[t].lines = lines;
+  }
+  size_t count = run_chunks (num_lines, sizeof (SummaryJob), summarize_chunk,
+                             jobs);
+  summary_init (summary);
+  for (size_t t = 0; t < count; ++t)
+  {
+    summary_merge (summary, &jobs[t].summary);
+  }
+  free (jobs);
+  return EXIT_SUCCESS;
+}
+
+/**
+ * Quantile function:
+ * walks the cumulative counts up to the rank of q
+ */
+int histogram_quantile (const Histogram *histogram, double q)
+{
+  if (histogram->count == 0)
+  {
+    return histogram->min;
+  }
+  size_t rank = quantile_rank (histogram->count, q);
+  size_t seen = 0;
+  for (int i = 0; i <= histogram->max - histogram->min; ++i)
+  {
+    seen += histogram->buckets[i];
+    if (seen >= rank)
+    {
+      return histogram->min + i;
+    }
+  }
+  return histogram->max;
+}
+
+/**
+ * Quantile function:
+ * finds the bucket of the rank of q and returns the middle of it,
+ * which is within SKETCH_ACCURACY of the exact quantile
+ */
+double sketch_quantile (const QuantileSketch *sketch, double q)
+{
+  if (sketch->count == 0)
+  {
+    return 0;
+  }
+  size_t rank = quantile_rank (sketch->count, q);
+  size_t seen = sketch->zero_count;
+  if (seen >= rank)
+  {
+    return 0;
+  }
+  double gamma = sketch_gamma ();
+  for (int i = 0; i < SKETCH_BUCKETS; ++i)
+  {
+    seen += sketch->buckets[i];
+    if (seen >= rank)
+    {
+      return 2 * pow (gamma, i - SKETCH_OFFSET) / (gamma + 1);
+    }
+  }
+  return 2 * pow (gamma, SKETCH_BUCKETS - 1 - SKETCH_OFFSET) / (gamma + 1);
+}
@@ -0,0 +1,78 @@
+#ifndef EX2_REPO_BUSLINESSTATS_H
+#define EX2_REPO_BUSLINESSTATS_H
+
+#include <stddef.h>
+#include "sort_bus_lines.h"
+
+#define STATS_MIN_DISTANCE 0
+#define STATS_MAX_DISTANCE 1000
+#define STATS_MIN_DURATION 10
+#define STATS_MAX_DURATION 100
+
+#define SKETCH_BUCKETS 1024
+#define SKETCH_OFFSET 512
+#define SKETCH_ACCURACY 0.01
+
+/**
+ * Exact histogram of an int attribute over a bounded domain,
+ * values outside of it are counted in the closest bucket
+ */
+typedef struct Histogram
+{
+    int min, max;
+    size_t count;
+    size_t buckets[STATS_MAX_DISTANCE + 1];
+} Histogram;
+
+/**
+ * Mergeable quantile sketch for positive derived values:
+ * logarithmic buckets give every quantile within SKETCH_ACCURACY
+ * relative error, and merging two sketches is adding the buckets
+ */
+typedef struct QuantileSketch
+{
+    size_t count, zero_count;
+    size_t buckets[SKETCH_BUCKETS];
+} QuantileSketch;
+
+/**
+ * Summary of a set of bus lines, built in a single pass
+ */
+typedef struct BusLineSummary
+{
+    Histogram distance, duration;
+    QuantileSketch speed;
+} BusLineSummary;
+
+/**
+ * Reset the summary to an empty one
+ */
+void summary_init (BusLineSummary *summary);
+
+/**
+ * Add one line to the summary
+ */
+void summary_add (BusLineSummary *summary, const BusLine *line);
+
+/**
+ * Add the partial summary other into summary
+ */
+void summary_merge (BusLineSummary *summary, const BusLineSummary *other);
+
+/**
+ * Summarize the lines with partial summaries on several threads
+ */
+int summarize_lines (const BusLine *lines, size_t num_lines,
+                     BusLineSummary *summary);
+
+/**
+ * Exact quantile of a histogram, q in [0, 1]
+ */
+int histogram_quantile (const Histogram *histogram, double q);
+
+/**
+ * Approximate quantile of a sketch, q in [0, 1]
+ */
+double sketch_quantile (const QuantileSketch *sketch, double q);
+
+#endif //EX2_REPO_BUSLINESSTATS_H
@@ -0,0 +1,134 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "bus_lines_writer.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define MAXDIGITS 12
+#define DECIMAL 10
+
+/**
+ * Open function:
+ * allocates the buffer, nothing is written until the first flush
+ */
+int writer_open (LineWriter *writer, int fd)
+{
+  writer->fd = fd;
+  writer->size = 0;
+  writer->failed = 0;
+  writer->buffer = malloc (WRITER_BUFFER_SIZE);
+  return writer->buffer == NULL ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/**
+ * Flush function:
+ * writes the whole buffer, retrying on short writes and interrupts
+ */
+int writer_flush (LineWriter *writer)
+{
+  size_t done = 0;
+  while (!writer->failed && done < writer->size)
+  {
+    ssize_t written = write (writer->fd, writer->buffer + done,
+                             writer->size - done);
+    if (written < 0 && errno != EINTR)
+    {
+      writer->failed = 1;
+    }
+    else if (written > 0)
+    {
+      done += (size_t) written;
+    }
+  }
+  writer->size = 0;
+  return writer->failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/**
+ * Helper function:
+ * makes room for one more record in the buffer
+ */
+static char *reserve (LineWriter *writer)
+{
+  if (WRITER_BUFFER_SIZE - writer->size < WRITER_MAX_LINE)
+  {
+    writer_flush (writer);
+  }
+  return writer->buffer + writer->size;
+}
+
+/**
+ * Helper function:
+ * formats a decimal integer into out, returns the end of the digits
+ */
+static char *put_int (char *out, int value)
+{
+  char digits[MAXDIGITS];
+  int count = 0;
+  unsigned int magnitude = value < 0 ? 0u - (unsigned int) value
+                                     : (unsigned int) value;
+  if (value < 0)
+  {
+    *out++ = '-';
+  }
+  do
+  {
+    digits[count++] = (char) ('0' + magnitude % DECIMAL);
+    magnitude /= DECIMAL;
+  }
+  while (magnitude != 0);
+  while (count > 0)
+  {
+    *out++ = digits[--count];
+  }
+  return out;
+}
+
+/**
+ * Put function:
+ * appends the line in the same format as printf ("%s,%d,%d\n")
+ */
+void writer_put_line (LineWriter *writer, const BusLine *line)
+{
+  char *start = reserve (writer);
+  char *out = start;
+  for (int i = 0; i < NAME_LEN - 1 && line->name[i] != '\0'; ++i)
+  {
+    *out++ = line->name[i];
+  }
+  *out++ = ',';
+  out = put_int (out, line->distance);
+  *out++ = ',';
+  out = put_int (out, line->duration);
+  *out++ = '\n';
+  writer->size += (size_t) (out - start);
+}
+
+/**
+ * Put function:
+ * appends the line as a snapshot record (zero padded name)
+ */
+void writer_put_binary (LineWriter *writer, const BusLine *line)
+{
+  BusLine record;
+  memset (&record, 0, sizeof (BusLine));
+  strncpy (record.name, line->name, NAME_LEN);
+  record.distance = line->distance;
+  record.duration = line->duration;
+  memcpy (reserve (writer), &record, sizeof (BusLine));
+  writer->size += sizeof (BusLine);
+}
+
+/**
+ * Close function:
+ * flushes what is left and frees the buffer
+ */
+int writer_close (LineWriter *writer)
+{
+  int result = writer_flush (writer);
+  free (writer->buffer);
+  writer->buffer = NULL;
+  return result;
+}
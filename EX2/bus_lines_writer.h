@@ -0,0 +1,48 @@
+#ifndef EX2_REPO_BUSLINESWRITER_H
+#define EX2_REPO_BUSLINESWRITER_H
+
+#include <stddef.h>
+#include "sort_bus_lines.h"
+
+#define WRITER_BUFFER_SIZE (1 << 20)
+#define WRITER_MAX_LINE 64
+
+/**
+ * Buffered writer of bus lines to a file descriptor.
+ * Lines are formatted by hand into one large buffer that is
+ * flushed with big write calls.
+ */
+typedef struct LineWriter
+{
+    int fd;
+    char *buffer;
+    size_t size;
+    int failed;
+} LineWriter;
+
+/**
+ * Prepare a writer for the file descriptor
+ */
+int writer_open (LineWriter *writer, int fd);
+
+/**
+ * Append a line as "name,distance,duration\n"
+ */
+void writer_put_line (LineWriter *writer, const BusLine *line);
+
+/**
+ * Append a line as a fixed-size binary record
+ */
+void writer_put_binary (LineWriter *writer, const BusLine *line);
+
+/**
+ * Write out the buffered bytes
+ */
+int writer_flush (LineWriter *writer);
+
+/**
+ * Flush and release the writer
+ */
+int writer_close (LineWriter *writer);
+
+#endif //EX2_REPO_BUSLINESWRITER_H
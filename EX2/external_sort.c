@@ -0,0 +1,351 @@
+#include "external_sort.h"
+#include "bus_lines_snapshot.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define READMODE "rb"
+#define WRITEMODE "wb"
+#define MINRUNRECORDS 1024
+#define MINMERGERECORDS 64
+
+/**
+ * Sorted run spilled to a temporary file, read back through a buffer
+ */
+typedef struct RunReader
+{
+    FILE *file;
+    BusLine *buffer;
+    size_t capacity, count, position;
+} RunReader;
+
+/**
+ * Growable list of the temporary run files
+ */
+typedef struct RunList
+{
+    FILE **files;
+    size_t size, capacity;
+} RunList;
+
+/**
+ * Loser tree over k runs: tree[0] is the current winner and
+ * tree[1..k-1] hold the loser of every internal match.
+ * The index k stands for a virtual run smaller than everything,
+ * used only while the tree is being built.
+ */
+typedef struct LoserTree
+{
+    RunReader *readers;
+    size_t *tree;
+    size_t k;
+    SortType sort_type;
+} LoserTree;
+
+/**
+ * Helper function:
+ * appends a run file to the list
+ */
+static int push_run (RunList *runs, FILE *file)
+{
+  if (runs->size == runs->capacity)
+  {
+    size_t capacity = runs->capacity ? 2 * runs->capacity : 16;
+    FILE **files = realloc (runs->files, capacity * sizeof (FILE *));
+    if (files == NULL)
+    {
+      return EXIT_FAILURE;
+    }
+    runs->files = files;
+    runs->capacity = capacity;
+  }
+  runs->files[runs->size++] = file;
+  return EXIT_SUCCESS;
+}
+
+/**
+ * Helper function:
+ * closes (and so deletes) every temporary file of the list
+ */
+static void free_runs (RunList *runs)
+{
+  for (size_t i = 0; i < runs->size; ++i)
+  {
+    fclose (runs->files[i]);
+  }
+  free (runs->files);
+  runs->files = NULL;
+  runs->size = 0;
+  runs->capacity = 0;
+}
+
+/**
+ * Helper function:
+ * reads the next block of a run, returns 0 once the run is exhausted
+ */
+static int refill (RunReader *reader)
+{
+  reader->count = fread (reader->buffer, sizeof (BusLine),
+                         reader->capacity, reader->file);
+  reader->position = 0;
+  return reader->count > 0;
+}
+
+/**
+ * Helper function:
+ * true if the head of run a is placed before the head of run b.
+ * Exhausted runs lose every match, ties go to the earlier run
+ * so the merge keeps the order of equal lines.
+ */
+static int run_beats (LoserTree *tree, size_t a, size_t b)
+{
+  if (a == tree->k || b == tree->k)
+  {
+    return a == tree->k;
+  }
+  RunReader *first = tree->readers + a;
+  RunReader *second = tree->readers + b;
+  if (first->position == first->count || second->position == second->count)
+  {
+    return second->position == second->count
+           && first->position < first->count;
+  }
+  int result = compare (first->buffer + first->position,
+                        second->buffer + second->position, tree->sort_type);
+  return result != 0 ? result < 0 : a < b;
+}
+
+/**
+ * Helper function:
+ * replays the matches on the path from the leaf of run s to the root
+ */
+static void adjust (LoserTree *tree, size_t s)
+{
+  for (size_t t = (s + tree->k) / 2; t > 0; t /= 2)
+  {
+    if (run_beats (tree, tree->tree[t], s))
+    {
+      size_t loser = s;
+      s = tree->tree[t];
+      tree->tree[t] = loser;
+    }
+  }
+  tree->tree[0] = s;
+}
+
+/**
+ * Helper function:
+ * pops winners of the tree into out until every run is exhausted
+ */
+static int drain_tree (LoserTree *tree, BusLine *output, size_t capacity,
+                       FILE *out)
+{
+  RunReader *readers = tree->readers;
+  size_t pending = 0;
+  while (readers[tree->tree[0]].position < readers[tree->tree[0]].count)
+  {
+    RunReader *winner = readers + tree->tree[0];
+    output[pending++] = winner->buffer[winner->position++];
+    if (pending == capacity)
+    {
+      if (fwrite (output, sizeof (BusLine), pending, out) != pending)
+      {
+        return EXIT_FAILURE;
+      }
+      pending = 0;
+    }
+    if (winner->position == winner->count)
+    {
+      refill (winner);
+    }
+    adjust (tree, tree->tree[0]);
+  }
+  if (fwrite (output, sizeof (BusLine), pending, out) != pending)
+  {
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+/**
+ * Merge function:
+ * k-way merges the sorted runs into out with a loser tree,
+ * so every output line costs log(k) comparisons
+ */
+static int merge_runs (FILE **files, size_t k, FILE *out,
+                       SortType sort_type, size_t memory_budget)
+{
+  size_t per_run = memory_budget / ((k + 1) * sizeof (BusLine));
+  per_run = per_run < MINMERGERECORDS ? MINMERGERECORDS : per_run;
+  RunReader *readers = calloc (k, sizeof (RunReader));
+  size_t *nodes = malloc ((k + 1) * sizeof (size_t));
+  BusLine *output = malloc (per_run * sizeof (BusLine));
+  BusLine *buffers = malloc (k * per_run * sizeof (BusLine));
+  int result = EXIT_FAILURE;
+
+  if (readers != NULL && nodes != NULL && output != NULL && buffers != NULL)
+  {
+    LoserTree tree = {readers, nodes, k, sort_type};
+    for (size_t i = 0; i < k; ++i)
+    {
+      readers[i] = (RunReader) {files[i], buffers + i * per_run,
+                                per_run, 0, 0};
+      refill (readers + i);
+      nodes[i] = k;
+    }
+    for (size_t i = k; i > 0; --i)
+    {
+      adjust (&tree, i - 1);
+    }
+    result = drain_tree (&tree, output, per_run, out);
+  }
+
+  free (readers);
+  free (nodes);
+  free (output);
+  free (buffers);
+  return result;
+}
+
+/**
+ * Helper function:
+ * splits the input into runs that, with their merge scratch,
+ * fit the memory budget,
+ * sorts each one in memory with the stable adaptive sort
+ * and spills it to a temporary file
+ */
+static int create_runs (FILE *input, size_t count, SortType sort_type,
+                        size_t memory_budget, RunList *runs)
+{
+  // tim_sort merges through a scratch buffer of up to half a run,
+  // so the run gets two thirds of the budget
+  size_t capacity = 2 * (memory_budget / (3 * sizeof (BusLine)));
+  capacity = capacity < MINRUNRECORDS ? MINRUNRECORDS : capacity;
+  capacity = capacity > count ? count : capacity;
+  BusLine *run = malloc ((capacity + 1) * sizeof (BusLine));
+  if (run == NULL)
+  {
+    return EXIT_FAILURE;
+  }
+  for (size_t done = 0; done < count;)
+  {
+    size_t size = count - done < capacity ? count - done : capacity;
+    FILE *file = NULL;
+    if (fread (run, sizeof (BusLine), size, input) != size
+        || (file = tmpfile ()) == NULL || push_run (runs, file))
+    {
+      if (file != NULL)
+      {
+        fclose (file);
+      }
+      free (run);
+      return EXIT_FAILURE;
+    }
+    tim_sort (run, run + size - 1, sort_type);
+    if (fwrite (run, sizeof (BusLine), size, file) != size)
+    {
+      free (run);
+      return EXIT_FAILURE;
+    }
+    rewind (file);
+    done += size;
+  }
+  free (run);
+  return EXIT_SUCCESS;
+}
+
+/**
+ * Helper function:
+ * merges groups of fan_in runs until a single final merge
+ * can keep a buffer of every remaining run within the budget
+ */
+static int reduce_runs (RunList *runs, SortType sort_type,
+                        size_t memory_budget)
+{
+  size_t fan_in = memory_budget / (MINMERGERECORDS * sizeof (BusLine));
+  fan_in = fan_in > 2 ? fan_in - 1 : 2;
+  while (runs->size > fan_in)
+  {
+    RunList merged = {NULL, 0, 0};
+    for (size_t first = 0; first < runs->size; first += fan_in)
+    {
+      size_t k = runs->size - first < fan_in ? runs->size - first : fan_in;
+      FILE *file = tmpfile ();
+      if (file == NULL || push_run (&merged, file))
+      {
+        if (file != NULL)
+        {
+          fclose (file);
+        }
+        free_runs (&merged);
+        return EXIT_FAILURE;
+      }
+      if (merge_runs (runs->files + first, k, file, sort_type,
+                      memory_budget))
+      {
+        free_runs (&merged);
+        return EXIT_FAILURE;
+      }
+      rewind (file);
+    }
+    free_runs (runs);
+    *runs = merged;
+  }
+  return EXIT_SUCCESS;
+}
+
+/**
+ * External sort:
+ * sorts the lines of the input snapshot into the output snapshot
+ * using at most about memory_budget bytes of buffers.
+ * Sorted runs are spilled to temporary files and k-way merged
+ * with a loser tree, in several passes if there are too many runs.
+ */
+int external_sort (const char *input_path, const char *output_path,
+                   SortType sort_type, size_t memory_budget)
+{
+  FILE *input = fopen (input_path, READMODE);
+  if (input == NULL)
+  {
+    return EXIT_FAILURE;
+  }
+  SnapshotHeader header;
+  if (fread (&header, sizeof (header), 1, input) != 1
+      || header.magic != SNAPSHOT_MAGIC || header.version != SNAPSHOT_VERSION
+      || header.record_size != sizeof (BusLine))
+  {
+    fclose (input);
+    return EXIT_FAILURE;
+  }
+
+  RunList runs = {NULL, 0, 0};
+  int result = create_runs (input, (size_t) header.count, sort_type,
+                            memory_budget, &runs);
+  fclose (input);
+  if (result == EXIT_SUCCESS)
+  {
+    result = reduce_runs (&runs, sort_type, memory_budget);
+  }
+
+  FILE *output = result == EXIT_SUCCESS ? fopen (output_path, WRITEMODE)
+                                        : NULL;
+  if (output == NULL)
+  {
+    free_runs (&runs);
+    return EXIT_FAILURE;
+  }
+  header.presorted = SNAPSHOT_SORTED(sort_type);
+  if (fwrite (&header, sizeof (header), 1, output) != 1
+      || (runs.size > 0
+          && merge_runs (runs.files, runs.size, output, sort_type,
+                         memory_budget)))
+  {
+    result = EXIT_FAILURE;
+  }
+  if (fclose (output) != 0)
+  {
+    result = EXIT_FAILURE;
+  }
+  free_runs (&runs);
+  return result;
+}
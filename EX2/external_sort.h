@@ -0,0 +1,15 @@
+#ifndef EX2_REPO_EXTERNALSORT_H
+#define EX2_REPO_EXTERNALSORT_H
+
+#include <stddef.h>
+#include "sort_bus_lines.h"
+
+#define DEFAULT_MEMORY_BUDGET ((size_t) 64 << 20)
+
+/**
+ * External merge sort of a snapshot file that may not fit in memory
+ */
+int external_sort (const char *input_path, const char *output_path,
+                   SortType sort_type, size_t memory_budget);
+
+#endif //EX2_REPO_EXTERNALSORT_H
@@ -1,9 +1,20 @@
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "sort_bus_lines.h"
 #include "test_bus_lines.h"
+#include "bus_lines_snapshot.h"
+#include "external_sort.h"
+#include "bus_lines_writer.h"
+#include "bus_lines_orderings.h"
+#include "bus_lines_stats.h"
+#include "bus_lines_derived.h"
+#include "bus_lines_groups.h"
+#include "bus_lines_compact.h"
+#include "bus_lines_index.h"
 
 #define BUFFERSIZE 63
 #define MAXLENGTH 21
@@ -18,6 +29,15 @@
 #define INPUTERROR "Error reading input \n"
 #define ENTERINFOSTR "Enter line info. Then enter\n"
 #define USAGEERROR "USAGE: you need to put only one argument \n"
+#define SNAPSHOTERROR "ERROR: The snapshot file is invalid \n"
+#define SNAPSHOTWRITEERROR "ERROR: Writing the snapshot failed \n"
+#define EXTERNALERROR "ERROR: The external sort failed \n"
+#define ORDERINGSERROR "ERROR: Writing the orderings failed \n"
+#define STATSERROR "ERROR: Summarizing the lines failed \n"
+#define DERIVEDERROR "ERROR: Sorting by the derived key failed \n"
+#define GROUPSERROR "ERROR: Grouping the lines failed \n"
+#define COMPACTERROR "ERROR: The compact storage failed \n"
+#define INDEXERROR "ERROR: Indexing the lines failed \n"
 
 #define POINTERERRORMSG "ERROR: There are no lines available \n"
 #define NAMEERRORMSG "ERROR: The name is invalid \n"
@@ -28,6 +48,31 @@
 #define BYDURATION "by_duration"
 #define BYNAME "by_name"
 #define TEST "test"
+#define ALL "all"
+#define STATS "stats"
+#define GROUPS "groups"
+#define SKIPLISTTEST "test_skiplist"
+#define DERIVEDPREFIX "by_"
+
+#define QUANTILEFORMAT "%s: p50=%d p95=%d p99=%d\n"
+#define SPEEDFORMAT "speed: p50=%.2f p95=%.2f p99=%.2f\n"
+#define GROUPFORMAT "%s,%zu,%d,%d,%.2f,%d,%d,%.2f\n"
+#define COUNTFORMAT "%zu\n"
+#define P50 0.50
+#define P95 0.95
+#define P99 0.99
+
+#define SNAPSHOTOPTION "--snapshot="
+#define EXTERNALOPTION "--external="
+#define BUDGETOPTION "--budget="
+#define ADAPTIVEOPTION "--adaptive"
+#define BINARYOPTION "--binary"
+#define COMPACTOPTION "--compact"
+#define OUTPUTOPTION "--output="
+#define RANGEOPTION "--range="
+#define BELOWOPTION "--below="
+#define RANGESEPARATOR ','
+#define DEFAULTOUTPUT ""
 
 #define TEST1 1
 #define TEST2 2
@@ -38,12 +83,14 @@
 
 #define TESTPASSED "TEST %d PASSED: "
 #define TESTFAILED "TEST %d FAILED: "
-#define DISTANCE "Sorted by distance \n"
-#define DURATION "Sorted by duration \n"
-#define NAME "Sorted by name \n"
+#define SORTEDDISTANCE "Sorted by distance \n"
+#define SORTEDDURATION "Sorted by duration \n"
+#define SORTEDNAME "Sorted by name \n"
 #define NOTDISTANCE "Not sorted by distance \n"
 #define NOTDURATION "Not sorted by duration \n"
 #define NOTNAME "Not sorted by name \n"
+#define SKIPLIST "Still sorted after streaming updates \n"
+#define NOTSKIPLIST "Not sorted after streaming updates \n"
 #define EQUAL "The array has not changed \n"
 #define NOTEQUAL "The array has changed \n"
 
@@ -52,13 +99,56 @@
 #define MAXDURATION 100
 #define MINDURATION 10
 
-void print_line (BusLine *lines, int num_lines)
+#define NOSORTTYPE (-1)
+#define NOQUERY 0
+#define RANGEQUERY 1
+#define BELOWQUERY 2
+
+typedef struct Options
+{
+    const char *snapshot;
+    const char *external;
+    size_t budget;
+    int adaptive;
+    int binary;
+    int compact;
+    const char *output;
+    int query;
+    int low, high;
+} Options;
+
+int print_ordered (BusLine *lines, const size_t *order, int num_lines,
+                   int binary)
 {
+  LineWriter writer;
+  fflush (stdout);
+  int buffered = writer_open (&writer, STDOUT_FILENO) == EXIT_SUCCESS;
   for (int i = 0; i < num_lines; ++i)
   {
-    printf ("%s,%d,%d\n",
-            lines[i].name, lines[i].distance, lines[i].duration);
+    BusLine *line = order == NULL ? lines + i : lines + order[i];
+    if (!buffered)
+    {
+      printf ("%s,%d,%d\n", line->name, line->distance, line->duration);
+    }
+    else if (binary)
+    {
+      writer_put_binary (&writer, line);
+    }
+    else
+    {
+      writer_put_line (&writer, line);
+    }
+  }
+  if (buffered)
+  {
+    return writer_close (&writer);
   }
+  return fflush (stdout) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int print_line (BusLine *lines, int num_lines, int binary)
+{
+  return print_ordered (lines, NULL, num_lines, binary);
 }
 
 int check_input (const char *name)
@@ -191,12 +281,43 @@ int get_parameters_input (BusLine *lines, char *buffer, int num_lines)
   return EXIT_SUCCESS;
 }
 
+int get_compact_input (CompactLines *compact, char *buffer, int num_lines)
+{
+  for (int i = 0; i < num_lines; ++i)
+  {
+    printf (ENTERINFOSTR);
+
+    if (fgets (buffer, BUFFERSIZE, stdin) == NULL)
+    {
+      printf (INPUTERROR);
+      return EXIT_FAILURE;
+    }
+
+    size_t length = strlen (buffer);
+    if (length > 0 && buffer[length - 1] == '\n')
+    {
+      buffer[length - 1] = '\0';
+    }
+
+    BusLine new_line;
+    if (get_line_parameters (&new_line, buffer) != 0)
+    {
+      --i;
+    }
+    else if (compact_append (compact, &new_line))
+    {
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
 int check_if_equal (BusLine *line_copy, BusLine *lines, int num_lines)
 {
   if (is_equal (line_copy,
-                line_copy + num_lines - 1,
+                line_copy + num_lines,
                 lines,
-                lines + num_lines - 1))
+                lines + num_lines))
   {
     return 0;
   }
@@ -211,7 +332,7 @@ int check_if_sorted_by_distance (BusLine *line, int num_lines)
   if (is_sorted_by_distance (line, line + num_lines - 1))
   {
     printf (TESTPASSED, TEST1);
-    printf (DISTANCE);
+    printf (SORTEDDISTANCE);
   }
   else
   {
@@ -227,13 +348,12 @@ int check_if_sorted_by_duration (BusLine *line, int num_lines)
   if (is_sorted_by_duration (line, line + num_lines - 1))
   {
     printf (TESTPASSED, TEST3);
-    printf (DURATION);
+    printf (SORTEDDURATION);
   }
   else
   {
     printf (TESTFAILED, TEST3);
     printf (NOTDURATION);
-    free (line);
     return 0;
   }
   return 1;
@@ -244,21 +364,21 @@ int check_if_sorted_by_name (BusLine *line, int num_lines)
   if (is_sorted_by_name (line, line + num_lines - 1))
   {
     printf (TESTPASSED, TEST5);
-    printf (NAME);
+    printf (SORTEDNAME);
   }
   else
   {
     printf (TESTFAILED, TEST5);
     printf (NOTNAME);
-    free (line);
     return 0;
   }
   return 1;
 }
 
-int check_if_is_equal (BusLine *line, int num_lines, int test)
+int check_if_is_equal (BusLine *line_copy, BusLine *lines, int num_lines,
+                       int test)
 {
-  if (!check_if_equal (line, line, num_lines))
+  if (!check_if_equal (line_copy, lines, num_lines))
   {
     printf (TESTPASSED, test);
     printf (EQUAL);
@@ -267,7 +387,6 @@ int check_if_is_equal (BusLine *line, int num_lines, int test)
   {
     printf (TESTFAILED, test);
     printf (NOTEQUAL);
-    free (line);
     return 0;
   }
   return 1;
@@ -279,36 +398,216 @@ void test_mode (BusLine *lines, int num_lines)
   line_copy = calloc (num_lines, sizeof (BusLine));
   line_copy = memcpy(line_copy, lines, num_lines * sizeof (BusLine));
   check_if_sorted_by_distance (line_copy, num_lines);
-  check_if_is_equal (line_copy, num_lines, TEST2);
+  check_if_is_equal (line_copy, lines, num_lines, TEST2);
   check_if_sorted_by_duration (line_copy, num_lines);
-  check_if_is_equal (line_copy, num_lines, TEST4);
+  check_if_is_equal (line_copy, lines, num_lines, TEST4);
   check_if_sorted_by_name (line_copy, num_lines);
-  check_if_is_equal (line_copy, num_lines, TEST6);
+  check_if_is_equal (line_copy, lines, num_lines, TEST6);
   free(line_copy);
   line_copy = NULL;
 }
 
-int do_tests (char *param, BusLine *lines, int num_lines)
+int skiplist_mode (BusLine *lines, int num_lines)
+{
+  if (!is_sorted_after_updates (lines, lines + num_lines - 1, DISTANCE))
+  {
+    printf (NOTSKIPLIST);
+    return EXIT_FAILURE;
+  }
+  printf (SKIPLIST);
+  return EXIT_SUCCESS;
+}
+
+int stats_mode (BusLine *lines, int num_lines)
+{
+  BusLineSummary *summary = malloc (sizeof (BusLineSummary));
+  if (summary == NULL || summarize_lines (lines, num_lines, summary))
+  {
+    free (summary);
+    printf (STATSERROR);
+    return EXIT_FAILURE;
+  }
+  printf (QUANTILEFORMAT, "distance",
+          histogram_quantile (&summary->distance, P50),
+          histogram_quantile (&summary->distance, P95),
+          histogram_quantile (&summary->distance, P99));
+  printf (QUANTILEFORMAT, "duration",
+          histogram_quantile (&summary->duration, P50),
+          histogram_quantile (&summary->duration, P95),
+          histogram_quantile (&summary->duration, P99));
+  printf (SPEEDFORMAT, sketch_quantile (&summary->speed, P50),
+          sketch_quantile (&summary->speed, P95),
+          sketch_quantile (&summary->speed, P99));
+  free (summary);
+  return EXIT_SUCCESS;
+}
+
+int groups_mode (BusLine *lines, int num_lines)
+{
+  GroupTable table;
+  if (group_by_name (lines, num_lines, &table))
+  {
+    printf (GROUPSERROR);
+    return EXIT_FAILURE;
+  }
+  LineGroup *groups = malloc ((table.size + 1) * sizeof (LineGroup));
+  if (groups == NULL)
+  {
+    free_groups (&table);
+    printf (GROUPSERROR);
+    return EXIT_FAILURE;
+  }
+  size_t count = collect_groups (&table, groups);
+  for (size_t i = 0; i < count; ++i)
+  {
+    printf (GROUPFORMAT, groups[i].name, groups[i].count,
+            groups[i].min_distance, groups[i].max_distance,
+            (double) groups[i].sum_distance / (double) groups[i].count,
+            groups[i].min_duration, groups[i].max_duration,
+            (double) groups[i].sum_duration / (double) groups[i].count);
+  }
+  free (groups);
+  free_groups (&table);
+  return EXIT_SUCCESS;
+}
+
+int derived_mode (BusLine *lines, int num_lines, const DerivedKey *key,
+                  const Options *options)
+{
+  size_t *order = malloc (((size_t) num_lines + 1) * sizeof (size_t));
+  if (order == NULL
+      || build_derived_order (lines, num_lines, key->compute, order))
+  {
+    free (order);
+    printf (DERIVEDERROR);
+    return EXIT_FAILURE;
+  }
+  int result = print_ordered (lines, order, num_lines, options->binary);
+  free (order);
+  return result;
+}
+
+int index_mode (BusLine *lines, int num_lines, int sort_type,
+                const Options *options)
+{
+  BusLineIndex index;
+  if (build_index (&index, lines, (size_t) num_lines))
+  {
+    printf (INDEXERROR);
+    return EXIT_FAILURE;
+  }
+  int result = EXIT_SUCCESS;
+  if (options->query == BELOWQUERY)
+  {
+    printf (COUNTFORMAT, index_count_below (&index, (SortType) sort_type,
+                                            options->low));
+  }
+  else
+  {
+    const size_t *positions = NULL;
+    size_t count = index_range (&index, (SortType) sort_type, options->low,
+                                options->high, &positions);
+    result = print_ordered (lines, positions, (int) count, options->binary);
+  }
+  free_index (&index);
+  return result;
+}
+
+const DerivedKey *mode_derived_key (const char *param)
+{
+  size_t length = strlen (DERIVEDPREFIX);
+  if (strncmp (param, DERIVEDPREFIX, length) != 0)
+  {
+    return NULL;
+  }
+  return find_derived_key (param + length);
+}
+
+int mode_sort_type (const char *param)
 {
   if (strcmp (param, BYDISTANCE) == 0)
   {
-    quick_sort (lines, lines + num_lines - 1, 0);
-    print_line (lines, num_lines);
+    return DISTANCE;
+  }
+  if (strcmp (param, BYDURATION) == 0)
+  {
+    return DURATION;
+  }
+  if (strcmp (param, BYNAME) == 0)
+  {
+    return NAME;
   }
-  else if (strcmp (param, BYDURATION) == 0)
+  return NOSORTTYPE;
+}
+
+unsigned int mode_flag (const char *param)
+{
+  int sort_type = mode_sort_type (param);
+  return sort_type == NOSORTTYPE ? 0 : SNAPSHOT_SORTED(sort_type);
+}
+
+void sort_lines (BusLine *lines, int num_lines, int sort_type,
+                 const Options *options)
+{
+  if (options->adaptive)
   {
-    quick_sort (lines, lines + num_lines - 1, 1);
-    print_line (lines, num_lines);
+    tim_sort (lines, lines + num_lines - 1, (SortType) sort_type);
   }
-  else if (strcmp (param, BYNAME) == 0)
+  else if (sort_type == NAME)
   {
     bubble_sort (lines, lines + num_lines - 1);
-    print_line (lines, num_lines);
+  }
+  else
+  {
+    quick_sort (lines, lines + num_lines - 1, (SortType) sort_type);
+  }
+}
+
+int do_tests (char *param, BusLine *lines, int num_lines,
+              unsigned int presorted, const Options *options)
+{
+  int sort_type = mode_sort_type (param);
+  if (sort_type != NOSORTTYPE && options->query != NOQUERY)
+  {
+    return index_mode (lines, num_lines, sort_type, options);
+  }
+  if (sort_type != NOSORTTYPE)
+  {
+    if (!(presorted & SNAPSHOT_SORTED(sort_type)))
+    {
+      sort_lines (lines, num_lines, sort_type, options);
+    }
+    return print_line (lines, num_lines, options->binary);
   }
   else if (strcmp (param, TEST) == 0)
   {
     test_mode (lines, num_lines);
   }
+  else if (mode_derived_key (param) != NULL)
+  {
+    return derived_mode (lines, num_lines, mode_derived_key (param), options);
+  }
+  else if (strcmp (param, SKIPLISTTEST) == 0)
+  {
+    return skiplist_mode (lines, num_lines);
+  }
+  else if (strcmp (param, STATS) == 0)
+  {
+    return stats_mode (lines, num_lines);
+  }
+  else if (strcmp (param, GROUPS) == 0)
+  {
+    return groups_mode (lines, num_lines);
+  }
+  else if (strcmp (param, ALL) == 0)
+  {
+    if (write_all_orderings (lines, (size_t) num_lines, options->output,
+                             options->binary))
+    {
+      printf (ORDERINGSERROR);
+      return EXIT_FAILURE;
+    }
+  }
   else
 
   {
@@ -318,6 +617,212 @@ int do_tests (char *param, BusLine *lines, int num_lines)
   return EXIT_SUCCESS;
 }
 
+const char *option_value (const char *arg, const char *option)
+{
+  size_t length = strlen (option);
+  if (strncmp (arg, option, length) == 0 && arg[length] != '\0')
+  {
+    return arg + length;
+  }
+  return NULL;
+}
+
+int parse_bound (const char *value, char separator, int *bound)
+{
+  char *end = NULL;
+  long number = strtol (value, &end, BASE10);
+  if (end == value || *end != separator || number < INT_MIN
+      || number > INT_MAX)
+  {
+    return EXIT_FAILURE;
+  }
+  *bound = (int) number;
+  return EXIT_SUCCESS;
+}
+
+int parse_query (const char *value, int query, Options *options)
+{
+  options->query = query;
+  if (query == BELOWQUERY)
+  {
+    return parse_bound (value, '\0', &options->low);
+  }
+  const char *separator = strchr (value, RANGESEPARATOR);
+  if (separator == NULL || parse_bound (value, RANGESEPARATOR, &options->low)
+      || parse_bound (separator + 1, '\0', &options->high))
+  {
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+int parse_options (int argc, char *argv[], Options *options)
+{
+  options->snapshot = NULL;
+  options->external = NULL;
+  options->budget = DEFAULT_MEMORY_BUDGET;
+  options->adaptive = 0;
+  options->binary = 0;
+  options->compact = 0;
+  options->output = DEFAULTOUTPUT;
+  options->query = NOQUERY;
+  for (int i = 2; i < argc; ++i)
+  {
+    const char *value = NULL;
+    if ((value = option_value (argv[i], SNAPSHOTOPTION)) != NULL)
+    {
+      options->snapshot = value;
+    }
+    else if ((value = option_value (argv[i], EXTERNALOPTION)) != NULL)
+    {
+      options->external = value;
+    }
+    else if (strcmp (argv[i], ADAPTIVEOPTION) == 0)
+    {
+      options->adaptive = 1;
+    }
+    else if ((value = option_value (argv[i], OUTPUTOPTION)) != NULL)
+    {
+      options->output = value;
+    }
+    else if (strcmp (argv[i], BINARYOPTION) == 0)
+    {
+      options->binary = 1;
+    }
+    else if (strcmp (argv[i], COMPACTOPTION) == 0)
+    {
+      options->compact = 1;
+    }
+    else if ((value = option_value (argv[i], RANGEOPTION)) != NULL)
+    {
+      if (options->query != NOQUERY || parse_query (value, RANGEQUERY,
+                                                     options))
+      {
+        return EXIT_FAILURE;
+      }
+    }
+    else if ((value = option_value (argv[i], BELOWOPTION)) != NULL)
+    {
+      if (options->query != NOQUERY || parse_query (value, BELOWQUERY,
+                                                     options))
+      {
+        return EXIT_FAILURE;
+      }
+    }
+    else if ((value = option_value (argv[i], BUDGETOPTION)) != NULL)
+    {
+      char *end = NULL;
+      options->budget = (size_t) strtoull (value, &end, BASE10);
+      if (*end != '\0' || options->budget == 0)
+      {
+        return EXIT_FAILURE;
+      }
+    }
+    else
+    {
+      return EXIT_FAILURE;
+    }
+  }
+  if (options->external != NULL
+      && (options->snapshot == NULL
+          || mode_sort_type (argv[1]) == NOSORTTYPE))
+  {
+    return EXIT_FAILURE;
+  }
+  if (options->compact
+      && (options->external != NULL
+          || mode_sort_type (argv[1]) == NOSORTTYPE))
+  {
+    return EXIT_FAILURE;
+  }
+  // only the numeric keys are indexed
+  if (options->query != NOQUERY
+      && (options->external != NULL || options->compact
+          || mode_sort_type (argv[1]) == NOSORTTYPE
+          || mode_sort_type (argv[1]) >= INDEXED_ATTRIBUTES))
+  {
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+int run_external (char *param, const Options *options)
+{
+  if (external_sort (options->snapshot, options->external,
+                     (SortType) mode_sort_type (param), options->budget))
+  {
+    printf (EXTERNALERROR);
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+int run_on_snapshot (char *param, const Options *options)
+{
+  BusLineSnapshot snapshot;
+  if (open_snapshot (options->snapshot, &snapshot) != SNAPSHOT_OK
+      || snapshot.num_lines == 0)
+  {
+    printf (SNAPSHOTERROR);
+    return EXIT_FAILURE;
+  }
+  int result = do_tests (param, snapshot.lines, (int) snapshot.num_lines,
+                         snapshot.presorted, options);
+  close_snapshot (&snapshot);
+  return result;
+}
+
+int run_compact (char *param, const Options *options)
+{
+  CompactLines compact;
+  unsigned int presorted = 0;
+  if (options->snapshot != NULL)
+  {
+    BusLineSnapshot snapshot;
+    if (open_snapshot (options->snapshot, &snapshot) != SNAPSHOT_OK
+        || snapshot.num_lines == 0)
+    {
+      printf (SNAPSHOTERROR);
+      return EXIT_FAILURE;
+    }
+    int result = compact_from_lines (snapshot.lines, snapshot.num_lines,
+                                     &compact);
+    presorted = snapshot.presorted;
+    close_snapshot (&snapshot);
+    if (result)
+    {
+      printf (COMPACTERROR);
+      return EXIT_FAILURE;
+    }
+  }
+  else
+  {
+    char buffer[BUFFERSIZE];
+    char lines_buffer[MAXLENGTH];
+    int num_lines = get_lines_input (lines_buffer);
+    if (compact_init (&compact, (size_t) num_lines)
+        || get_compact_input (&compact, buffer, num_lines))
+    {
+      compact_free (&compact);
+      printf (COMPACTERROR);
+      return EXIT_FAILURE;
+    }
+  }
+
+  int sort_type = mode_sort_type (param);
+  int result = EXIT_SUCCESS;
+  fflush (stdout);
+  if ((!(presorted & SNAPSHOT_SORTED(sort_type))
+       && compact_sort (&compact, (SortType) sort_type))
+      || compact_write (&compact, STDOUT_FILENO, options->binary))
+  {
+    printf (COMPACTERROR);
+    result = EXIT_FAILURE;
+  }
+  compact_free (&compact);
+  return result;
+}
+
 int main (int argc, char *argv[])
 {
   int num_lines = 0;
@@ -326,11 +831,27 @@ int main (int argc, char *argv[])
   char buffer[BUFFERSIZE];
   char lines_buffer[MAXLENGTH];
 
-  if (argc == 1 || argc > 2) {
+  Options options;
+  if (argc == 1 || parse_options (argc, argv, &options)) {
     printf(USAGEERROR);
     return EXIT_FAILURE;
   }
 
+  if (options.external != NULL)
+  {
+    return run_external (argv[1], &options);
+  }
+
+  if (options.compact)
+  {
+    return run_compact (argv[1], &options);
+  }
+
+  if (options.snapshot != NULL && access (options.snapshot, F_OK) == 0)
+  {
+    return run_on_snapshot (argv[1], &options);
+  }
+
   int temp = get_lines_input (lines_buffer);
   if (temp)
   {
@@ -347,9 +868,16 @@ int main (int argc, char *argv[])
 
   get_parameters_input (lines, buffer, num_lines);
 
-  do_tests (argv[1], lines, num_lines);
+  int result = do_tests (argv[1], lines, num_lines, 0, &options);
+  if (result == EXIT_SUCCESS && options.snapshot != NULL
+      && write_snapshot (options.snapshot, lines, num_lines,
+                         options.query == NOQUERY ? mode_flag (argv[1]) : 0))
+  {
+    printf (SNAPSHOTWRITEERROR);
+    result = EXIT_FAILURE;
+  }
 
   free (lines);
   lines = NULL;
-  return EXIT_SUCCESS;
+  return result;
 }
\ No newline at end of file
@@ -1,11 +1,44 @@
 #include "sort_bus_lines.h"
 
+#include <stdint.h>
+#include <stdlib.h>
+
+#define MINMERGE 64
+#define MINGALLOP 7
+#define MAXRUNS 85
+#define NETWORKSIZE 16
+#define NETWORKLENGTH 63
+#define KEYSHIFT 32
+#define KEYSIGN 0x80000000u
+#define FNVOFFSET 14695981039346656037ULL
+#define FNVPRIME 1099511628211ULL
+
+#ifdef BUS_LINES_COUNT_OPS
+unsigned long long sort_comparisons = 0;
+unsigned long long sort_moves = 0;
+#endif
+
+/**
+ * Batcher odd-even merge sort network for 16 elements
+ */
+static const unsigned char network[NETWORKLENGTH][2] = {
+    {0, 1}, {2, 3}, {4, 5}, {6, 7}, {8, 9}, {10, 11}, {12, 13}, {14, 15},
+    {0, 2}, {1, 3}, {4, 6}, {5, 7}, {8, 10}, {9, 11}, {12, 14}, {13, 15},
+    {1, 2}, {5, 6}, {9, 10}, {13, 14}, {0, 4}, {1, 5}, {2, 6}, {3, 7},
+    {8, 12}, {9, 13}, {10, 14}, {11, 15}, {2, 4}, {3, 5}, {10, 12},
+    {11, 13}, {1, 2}, {3, 4}, {5, 6}, {9, 10}, {11, 12}, {13, 14},
+    {0, 8}, {1, 9}, {2, 10}, {3, 11}, {4, 12}, {5, 13}, {6, 14}, {7, 15},
+    {4, 8}, {5, 9}, {6, 10}, {7, 11}, {2, 4}, {3, 5}, {6, 8}, {7, 9},
+    {10, 12}, {11, 13}, {1, 2}, {3, 4}, {5, 6}, {7, 8}, {9, 10},
+    {11, 12}, {13, 14}};
+
 /**
  * Swap helper function:
  * swaps two elements using temporary variable
  */
 void swap (BusLine *a, BusLine *b)
 {
+  COUNT_MOVES (3);
   BusLine temp = *a;
   *a = *b;
   *b = temp;
@@ -15,21 +48,38 @@ void swap (BusLine *a, BusLine *b)
  * Compare helper function:
  * given two lines and sorting type,
  * returns the comparison between values:
- * distance or duration accordingly
+ * distance, duration or name accordingly
  */
 int compare (BusLine *a, BusLine *b, SortType sort_type)
 {
+  COUNT_COMPARISONS (1);
   switch (sort_type)
   {
     case DISTANCE:
       return a->distance - b->distance;
     case DURATION:
       return a->duration - b->duration;
+    case NAME:
+      return strcmp (a->name, b->name);
     default:
       return 0;  // Unsupported SortType, no specific ordering
   }
 }
 
+/**
+ * Hash helper function:
+ * FNV-1a hash of a bus line name, up to its terminating NUL
+ */
+uint64_t hash_name (const char *name)
+{
+  uint64_t hash = FNVOFFSET;
+  for (int i = 0; i < NAME_LEN && name[i] != '\0'; ++i)
+  {
+    hash = (hash ^ (unsigned char) name[i]) * FNVPRIME;
+  }
+  return hash;
+}
+
 /**
  * Partition helper function:
  * Takes two pointers i and j (low and high)
@@ -57,6 +107,98 @@ BusLine *partition (BusLine *start, BusLine *end, SortType sort_type)
   return i + 1;
 }
 
+/**
+ * Run stack and merge buffer of the adaptive sort
+ */
+typedef struct TimState
+{
+    BusLine *buffer;
+    size_t buffer_size;
+    size_t min_gallop;
+    BusLine *run_base[MAXRUNS];
+    size_t run_len[MAXRUNS];
+    int runs;
+} TimState;
+
+/**
+ * Helper function:
+ * minimal run length, so that n / minrun is close to a power of two
+ */
+static size_t min_run_length (size_t n)
+{
+  size_t r = 0;
+  while (n >= MINMERGE)
+  {
+    r |= n & 1;
+    n >>= 1;
+  }
+  return n + r;
+}
+
+/**
+ * Helper function:
+ * reverses the lines between lo and hi (inclusive)
+ */
+static void reverse_range (BusLine *lo, BusLine *hi)
+{
+  while (lo < hi)
+  {
+    swap (lo++, hi--);
+  }
+}
+
+/**
+ * Helper function:
+ * sorts 16 packed (key, index) words with the network.
+ * Every compare-exchange is a branchless min/max, so there is
+ * nothing to mispredict and the compiler can use conditional moves.
+ */
+static void sort_network (uint64_t *words)
+{
+  COUNT_COMPARISONS (NETWORKLENGTH);
+  for (int i = 0; i < NETWORKLENGTH; ++i)
+  {
+    uint64_t a = words[network[i][0]];
+    uint64_t b = words[network[i][1]];
+    words[network[i][0]] = a < b ? a : b;
+    words[network[i][1]] = a < b ? b : a;
+  }
+}
+
+/**
+ * Helper function:
+ * makes sure the merge buffer holds at least size lines
+ */
+static int ensure_buffer (TimState *state, size_t size)
+{
+  if (state->buffer_size >= size)
+  {
+    return EXIT_SUCCESS;
+  }
+  BusLine *buffer = realloc (state->buffer, size * sizeof (BusLine));
+  if (buffer == NULL)
+  {
+    return EXIT_FAILURE;
+  }
+  state->buffer = buffer;
+  state->buffer_size = size;
+  return EXIT_SUCCESS;
+}
+
+#define SORT_SUFFIX distance
+#define SORT_BEFORE(a, b) ((a)->distance < (b)->distance)
+#define SORT_KEY(a) ((a)->distance)
+#include "sort_bus_lines_template.h"
+
+#define SORT_SUFFIX duration
+#define SORT_BEFORE(a, b) ((a)->duration < (b)->duration)
+#define SORT_KEY(a) ((a)->duration)
+#include "sort_bus_lines_template.h"
+
+#define SORT_SUFFIX name
+#define SORT_BEFORE(a, b) (strcmp ((a)->name, (b)->name) < 0)
+#include "sort_bus_lines_template.h"
+
 /**
  * Quick sort algorithm:
  * divide-and-conquer type of algorithm
@@ -66,12 +208,19 @@ BusLine *partition (BusLine *start, BusLine *end, SortType sort_type)
  */
 void quick_sort (BusLine *start, BusLine *end, SortType sort_type)
 {
-  if (start < end)
+  switch (sort_type)
   {
-    BusLine *pivot = partition (start, end, sort_type);
-
-    quick_sort (start, pivot - 1, sort_type);
-    quick_sort (pivot + 1, end, sort_type);
+    case DISTANCE:
+      quick_sort_distance (start, end);
+      break;
+    case DURATION:
+      quick_sort_duration (start, end);
+      break;
+    case NAME:
+      quick_sort_name (start, end);
+      break;
+    default:
+      break;  // Unsupported SortType, no specific ordering
   }
 }
 
@@ -88,8 +237,10 @@ void bubble_sort (BusLine *start, BusLine *end)
   {
     for (BusLine *j = start; j < end; ++j)
     {
+      COUNT_COMPARISONS (1);
       if (strcmp (j->name, (j + 1)->name) > 0)
       {
+        COUNT_MOVES (3);
         BusLine temp;
         memcpy(&temp, j, sizeof (BusLine));
         memcpy(j, j + 1, sizeof (BusLine));
@@ -99,3 +250,27 @@ void bubble_sort (BusLine *start, BusLine *end)
   }
 }
 
+/**
+ * Adaptive sort algorithm:
+ * TimSort - splits the array into natural ascending runs (strictly
+ * descending runs are reversed), extends short runs with binary
+ * insertion sort and merges them with galloping.
+ * Stable, and close to O(n) on nearly sorted input.
+ */
+void tim_sort (BusLine *start, BusLine *end, SortType sort_type)
+{
+  switch (sort_type)
+  {
+    case DISTANCE:
+      tim_sort_distance (start, end);
+      break;
+    case DURATION:
+      tim_sort_duration (start, end);
+      break;
+    case NAME:
+      tim_sort_name (start, end);
+      break;
+    default:
+      break;  // Unsupported SortType, no specific ordering
+  }
+}
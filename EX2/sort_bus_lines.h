@@ -1,9 +1,26 @@
 #ifndef EX2_REPO_SORTBUSLINES_H
 #define EX2_REPO_SORTBUSLINES_H
 
+#include <stdint.h>
 #include <string.h>
 #define NAME_LEN 21
 
+/**
+ * Operation counters for the benchmark, only compiled in when
+ * BUS_LINES_COUNT_OPS is defined (they are not thread safe).
+ * A move is one element written to the array being sorted or to a
+ * scratch copy of it, so a swap is three moves.
+ */
+#ifdef BUS_LINES_COUNT_OPS
+extern unsigned long long sort_comparisons;
+extern unsigned long long sort_moves;
+#define COUNT_COMPARISONS(n) (sort_comparisons += (n))
+#define COUNT_MOVES(n) (sort_moves += (n))
+#else
+#define COUNT_COMPARISONS(n) ((void) 0)
+#define COUNT_MOVES(n) ((void) 0)
+#endif
+
 typedef struct BusLine
 {
     char name[NAME_LEN];
@@ -12,7 +29,8 @@ typedef struct BusLine
 typedef enum SortType
 {
     DISTANCE,
-    DURATION
+    DURATION,
+    NAME
 } SortType;
 
 /**
@@ -25,6 +43,11 @@ void bubble_sort (BusLine *start, BusLine *end);
  */
 void quick_sort (BusLine *start, BusLine *end, SortType sort_type);
 
+/**
+ * Adaptive stable sort algorithm (TimSort)
+ */
+void tim_sort (BusLine *start, BusLine *end, SortType sort_type);
+
 /**
  * Partition helper function
  */
@@ -40,4 +63,9 @@ void swap (BusLine *a, BusLine *b);
  */
 int compare (BusLine *a, BusLine *b, SortType sort_type);
 
+/**
+ * Hash helper function
+ */
+uint64_t hash_name (const char *name);
+
 #endif //EX2_REPO_SORTBUSLINES_H
@@ -0,0 +1,503 @@
+/**
+ * Sort routines specialized for a single key.
+ * Included by sort_bus_lines.c once per key, with
+ *   SORT_SUFFIX         - suffix of the generated function names
+ *   SORT_BEFORE(a, b)   - strict "a is placed before b" on that key
+ *   SORT_KEY(a)         - (optional) the int key, enables the
+ *                         sorting network base case
+ * so every comparison is inlined and the hot loops never switch
+ * on the SortType. Deliberately has no include guard.
+ */
+
+#define SORT_CONCAT_(name, suffix) name##_##suffix
+#define SORT_CONCAT(name, suffix) SORT_CONCAT_(name, suffix)
+#define SORT_FN(name) SORT_CONCAT(name, SORT_SUFFIX)
+
+/**
+ * Helper function:
+ * strict order of the lines by the key of this instance. Equal lines
+ * are never "before" each other, which keeps the adaptive sort stable.
+ */
+static inline int SORT_FN(before) (const BusLine *a, const BusLine *b)
+{
+  COUNT_COMPARISONS (1);
+  return SORT_BEFORE (a, b);
+}
+
+/**
+ * Partition helper function:
+ * Lomuto partition around the last element, same as partition()
+ * but with the key comparison inlined
+ */
+static BusLine *SORT_FN(partition) (BusLine *start, BusLine *end)
+{
+  BusLine *i = start - 1;
+  for (BusLine *j = start; j < end; j++)
+  {
+    if (SORT_FN(before) (j, end))
+    {
+      i++;
+      swap (i, j);
+    }
+  }
+  swap (i + 1, end);
+  return i + 1;
+}
+
+#ifdef SORT_KEY
+/**
+ * Small sort:
+ * packs (key, index) pairs into 64-bit words, sorts them with the
+ * branchless network and then moves the lines once into place
+ */
+static void SORT_FN(small_sort) (BusLine *start, size_t n)
+{
+  uint64_t words[NETWORKSIZE];
+  BusLine lines[NETWORKSIZE];
+  for (size_t i = 0; i < NETWORKSIZE; ++i)
+  {
+    words[i] = i < n ? ((uint64_t) ((uint32_t) SORT_KEY (start + i) ^ KEYSIGN)
+                        << KEYSHIFT) | i
+                     : UINT64_MAX;
+  }
+  sort_network (words);
+  COUNT_MOVES (2 * n);
+  memcpy (lines, start, n * sizeof (BusLine));
+  for (size_t i = 0; i < n; ++i)
+  {
+    start[i] = lines[(uint32_t) words[i]];
+  }
+}
+#else
+/**
+ * Small sort:
+ * insertion sort, for keys that can not be packed into a word
+ */
+static void SORT_FN(small_sort) (BusLine *start, size_t n)
+{
+  for (size_t i = 1; i < n; ++i)
+  {
+    BusLine pivot = start[i];
+    size_t j = i;
+    while (j > 0 && SORT_FN(before) (&pivot, start + j - 1))
+    {
+      start[j] = start[j - 1];
+      --j;
+    }
+    start[j] = pivot;
+    COUNT_MOVES (i - j + 2);
+  }
+}
+#endif
+
+/**
+ * Quick sort algorithm:
+ * same algorithm as quick_sort() for a single key, except that
+ * partitions of up to NETWORKSIZE lines go to the small sort
+ */
+static void SORT_FN(quick_sort) (BusLine *start, BusLine *end)
+{
+  if (end - start < NETWORKSIZE)
+  {
+    if (start < end)
+    {
+      SORT_FN(small_sort) (start, (size_t) (end - start) + 1);
+    }
+  }
+  else
+  {
+    BusLine *pivot = SORT_FN(partition) (start, end);
+
+    SORT_FN(quick_sort) (start, pivot - 1);
+    SORT_FN(quick_sort) (pivot + 1, end);
+  }
+}
+
+/**
+ * Helper function:
+ * finds the run starting at lo. A strictly descending run is reversed
+ * in place (strictness keeps equal lines in order).
+ * Returns the length of the run.
+ */
+static size_t SORT_FN(count_run) (BusLine *lo, size_t n)
+{
+  size_t length = 1;
+  if (n == 1)
+  {
+    return length;
+  }
+  if (SORT_FN(before) (lo + 1, lo))
+  {
+    while (length < n && SORT_FN(before) (lo + length, lo + length - 1))
+    {
+      ++length;
+    }
+    reverse_range (lo, lo + length - 1);
+  }
+  else
+  {
+    while (length < n && !SORT_FN(before) (lo + length, lo + length - 1))
+    {
+      ++length;
+    }
+  }
+  return length;
+}
+
+/**
+ * Helper function:
+ * stable binary insertion sort of lo[0..n), where lo[0..sorted)
+ * is already in order
+ */
+static void SORT_FN(binary_insertion_sort) (BusLine *lo, size_t n,
+                                            size_t sorted)
+{
+  for (size_t i = sorted; i < n; ++i)
+  {
+    BusLine pivot = lo[i];
+    size_t left = 0;
+    size_t right = i;
+    while (left < right)
+    {
+      size_t middle = left + (right - left) / 2;
+      if (SORT_FN(before) (&pivot, lo + middle))
+      {
+        right = middle;
+      }
+      else
+      {
+        left = middle + 1;
+      }
+    }
+    memmove (lo + left + 1, lo + left, (i - left) * sizeof (BusLine));
+    lo[left] = pivot;
+    COUNT_MOVES (i - left + 2);
+  }
+}
+
+/**
+ * Helper function:
+ * exponential then binary search, returns the amount of lines
+ * in arr[0..n) that are not after key (upper bound)
+ */
+static size_t SORT_FN(gallop_right) (const BusLine *key, const BusLine *arr,
+                                     size_t n)
+{
+  size_t last = 0;
+  size_t offset = 1;
+  if (n == 0 || SORT_FN(before) (key, arr))
+  {
+    return 0;
+  }
+  while (offset < n && !SORT_FN(before) (key, arr + offset))
+  {
+    last = offset;
+    offset = 2 * offset + 1;
+  }
+  offset = offset < n ? offset : n;
+  ++last;
+  while (last < offset)
+  {
+    size_t middle = last + (offset - last) / 2;
+    if (SORT_FN(before) (key, arr + middle))
+    {
+      offset = middle;
+    }
+    else
+    {
+      last = middle + 1;
+    }
+  }
+  return last;
+}
+
+/**
+ * Helper function:
+ * exponential then binary search, returns the amount of lines
+ * in arr[0..n) that are before key (lower bound)
+ */
+static size_t SORT_FN(gallop_left) (const BusLine *key, const BusLine *arr,
+                                    size_t n)
+{
+  size_t last = 0;
+  size_t offset = 1;
+  if (n == 0 || !SORT_FN(before) (arr, key))
+  {
+    return 0;
+  }
+  while (offset < n && SORT_FN(before) (arr + offset, key))
+  {
+    last = offset;
+    offset = 2 * offset + 1;
+  }
+  offset = offset < n ? offset : n;
+  ++last;
+  while (last < offset)
+  {
+    size_t middle = last + (offset - last) / 2;
+    if (SORT_FN(before) (arr + middle, key))
+    {
+      last = middle + 1;
+    }
+    else
+    {
+      offset = middle;
+    }
+  }
+  return last;
+}
+
+/**
+ * Helper function:
+ * merges the adjacent runs a and b from the left, copying a aside.
+ * Switches to galloping when one run keeps winning.
+ */
+static void SORT_FN(merge_low) (TimState *state, BusLine *a, size_t na,
+                                BusLine *b, size_t nb)
+{
+  BusLine *pa = state->buffer;
+  BusLine *pb = b;
+  BusLine *dest = a;
+  COUNT_MOVES (na);
+  memcpy (pa, a, na * sizeof (BusLine));
+  while (na > 0 && nb > 0)
+  {
+    size_t wins_a = 0;
+    size_t wins_b = 0;
+    while (na > 0 && nb > 0 && wins_a < state->min_gallop
+           && wins_b < state->min_gallop)
+    {
+      if (SORT_FN(before) (pb, pa))
+      {
+        COUNT_MOVES (1);
+        *dest++ = *pb++;
+        --nb;
+        ++wins_b;
+        wins_a = 0;
+      }
+      else
+      {
+        COUNT_MOVES (1);
+        *dest++ = *pa++;
+        --na;
+        ++wins_a;
+        wins_b = 0;
+      }
+    }
+    if (na == 0 || nb == 0)
+    {
+      break;
+    }
+    do
+    {
+      wins_a = SORT_FN(gallop_right) (pb, pa, na);
+      COUNT_MOVES (wins_a);
+      memcpy (dest, pa, wins_a * sizeof (BusLine));
+      dest += wins_a;
+      pa += wins_a;
+      na -= wins_a;
+      if (na == 0)
+      {
+        break;
+      }
+      wins_b = SORT_FN(gallop_left) (pa, pb, nb);
+      COUNT_MOVES (wins_b);
+      memmove (dest, pb, wins_b * sizeof (BusLine));
+      dest += wins_b;
+      pb += wins_b;
+      nb -= wins_b;
+      state->min_gallop -= state->min_gallop > 1;
+    }
+    while (nb > 0 && (wins_a >= MINGALLOP || wins_b >= MINGALLOP));
+    state->min_gallop += 2;
+  }
+  COUNT_MOVES (na);
+  memcpy (dest, pa, na * sizeof (BusLine));
+}
+
+/**
+ * Helper function:
+ * merges the adjacent runs a and b from the right, copying b aside.
+ * Switches to galloping when one run keeps winning.
+ */
+static void SORT_FN(merge_high) (TimState *state, BusLine *a, size_t na,
+                                 BusLine *b, size_t nb)
+{
+  BusLine *base = state->buffer;
+  COUNT_MOVES (nb);
+  memcpy (base, b, nb * sizeof (BusLine));
+  BusLine *dest = b + nb;
+  while (na > 0 && nb > 0)
+  {
+    size_t wins_a = 0;
+    size_t wins_b = 0;
+    while (na > 0 && nb > 0 && wins_a < state->min_gallop
+           && wins_b < state->min_gallop)
+    {
+      if (SORT_FN(before) (base + nb - 1, a + na - 1))
+      {
+        COUNT_MOVES (1);
+        *--dest = a[--na];
+        ++wins_a;
+        wins_b = 0;
+      }
+      else
+      {
+        COUNT_MOVES (1);
+        *--dest = base[--nb];
+        ++wins_b;
+        wins_a = 0;
+      }
+    }
+    if (na == 0 || nb == 0)
+    {
+      break;
+    }
+    do
+    {
+      wins_b = nb - SORT_FN(gallop_left) (a + na - 1, base, nb);
+      dest -= wins_b;
+      nb -= wins_b;
+      COUNT_MOVES (wins_b);
+      memcpy (dest, base + nb, wins_b * sizeof (BusLine));
+      if (nb == 0)
+      {
+        break;
+      }
+      wins_a = na - SORT_FN(gallop_right) (base + nb - 1, a, na);
+      dest -= wins_a;
+      na -= wins_a;
+      COUNT_MOVES (wins_a);
+      memmove (dest, a + na, wins_a * sizeof (BusLine));
+      state->min_gallop -= state->min_gallop > 1;
+    }
+    while (na > 0 && (wins_a >= MINGALLOP || wins_b >= MINGALLOP));
+    state->min_gallop += 2;
+  }
+  COUNT_MOVES (nb);
+  memcpy (dest - nb, base, nb * sizeof (BusLine));
+}
+
+/**
+ * Helper function:
+ * merges runs i and i + 1 of the stack. The prefix of the first run
+ * and the suffix of the second one that are already in place are
+ * skipped with galloping searches before the actual merge.
+ */
+static int SORT_FN(merge_at) (TimState *state, int i)
+{
+  BusLine *a = state->run_base[i];
+  size_t na = state->run_len[i];
+  BusLine *b = state->run_base[i + 1];
+  size_t nb = state->run_len[i + 1];
+  state->run_len[i] = na + nb;
+  for (int j = i + 1; j < state->runs - 1; ++j)
+  {
+    state->run_base[j] = state->run_base[j + 1];
+    state->run_len[j] = state->run_len[j + 1];
+  }
+  --state->runs;
+
+  size_t skip = SORT_FN(gallop_right) (b, a, na);
+  a += skip;
+  na -= skip;
+  if (na == 0)
+  {
+    return EXIT_SUCCESS;
+  }
+  nb = SORT_FN(gallop_left) (a + na - 1, b, nb);
+  if (nb == 0)
+  {
+    return EXIT_SUCCESS;
+  }
+  if (ensure_buffer (state, na < nb ? na : nb))
+  {
+    SORT_FN(binary_insertion_sort) (a, na + nb, na);
+    return EXIT_FAILURE;
+  }
+  if (na <= nb)
+  {
+    SORT_FN(merge_low) (state, a, na, b, nb);
+  }
+  else
+  {
+    SORT_FN(merge_high) (state, a, na, b, nb);
+  }
+  return EXIT_SUCCESS;
+}
+
+/**
+ * Helper function:
+ * merges runs on top of the stack until the run lengths
+ * decrease fast enough (each run longer than the two above it)
+ */
+static void SORT_FN(merge_collapse) (TimState *state)
+{
+  while (state->runs > 1)
+  {
+    int n = state->runs - 2;
+    size_t *len = state->run_len;
+    if ((n > 0 && len[n - 1] <= len[n] + len[n + 1])
+        || (n > 1 && len[n - 2] <= len[n - 1] + len[n]))
+    {
+      if (len[n - 1] < len[n + 1])
+      {
+        --n;
+      }
+    }
+    else if (len[n] > len[n + 1])
+    {
+      break;
+    }
+    SORT_FN(merge_at) (state, n);
+  }
+}
+
+/**
+ * Adaptive sort algorithm:
+ * TimSort for a single key, see tim_sort()
+ */
+static void SORT_FN(tim_sort) (BusLine *start, BusLine *end)
+{
+  if (start >= end)
+  {
+    return;
+  }
+  size_t remaining = (size_t) (end - start) + 1;
+  size_t min_run = min_run_length (remaining);
+  TimState state = {NULL, 0, MINGALLOP, {NULL}, {0}, 0};
+  BusLine *lo = start;
+  while (remaining > 0)
+  {
+    size_t length = SORT_FN(count_run) (lo, remaining);
+    if (length < min_run)
+    {
+      size_t forced = remaining < min_run ? remaining : min_run;
+      SORT_FN(binary_insertion_sort) (lo, forced, length);
+      length = forced;
+    }
+    state.run_base[state.runs] = lo;
+    state.run_len[state.runs] = length;
+    ++state.runs;
+    SORT_FN(merge_collapse) (&state);
+    lo += length;
+    remaining -= length;
+  }
+  while (state.runs > 1)
+  {
+    int n = state.runs - 2;
+    if (n > 0 && state.run_len[n - 1] < state.run_len[n + 1])
+    {
+      --n;
+    }
+    SORT_FN(merge_at) (&state, n);
+  }
+  free (state.buffer);
+}
+
+#undef SORT_FN
+#undef SORT_CONCAT
+#undef SORT_CONCAT_
+#undef SORT_BEFORE
+#undef SORT_KEY
+#undef SORT_SUFFIX
@@ -1,14 +1,52 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include "test_bus_lines.h"
 #include "sort_bus_lines.h"
+#include "bus_lines_skiplist.h"
+#include "bus_lines_parallel.h"
 
+#include <stddef.h>
 #include <stdlib.h>
 
+#define MINTABLESIZE 16
+
+/**
+ * Name and its remaining count in the is_equal hash table
+ */
+typedef struct NameCount
+{
+    size_t hash;
+    long count;
+    int used;
+    char name[NAME_LEN];
+} NameCount;
+
+/**
+ * Open addressing table of names, grown when half full
+ */
+typedef struct NameTable
+{
+    NameCount *slots;
+    size_t capacity, size;
+} NameTable;
+
+/**
+ * Range of adjacent pairs checked by one thread,
+ * pair i is (start + i, start + i + 1)
+ */
+typedef struct SortedChunk
+{
+    LineChunk chunk;
+    BusLine *start;
+    SortType sort_type;
+    int sorted;
+} SortedChunk;
+
 /**
  * Helper function:
- * checks if the array is sorted accordingly to sort type (distance or duration),
- * using compare function from sort_bus_lines.c
+ * single pass over the pairs (i, i + 1) with start <= i < end - 1
  */
-int is_sorted (BusLine *start, BusLine *end, SortType sort_type)
+static int is_sorted_range (BusLine *start, BusLine *end, SortType sort_type)
 {
   for (BusLine *current = start; current < end - 1; current++)
   {
@@ -20,6 +58,47 @@ int is_sorted (BusLine *start, BusLine *end, SortType sort_type)
   return 1;
 }
 
+/**
+ * Helper function:
+ * thread entry point checking one chunk
+ */
+static void *is_sorted_chunk (void *arg)
+{
+  SortedChunk *job = arg;
+  job->sorted = is_sorted_range (job->start + job->chunk.first,
+                                 job->start + job->chunk.last + 1,
+                                 job->sort_type);
+  return NULL;
+}
+
+/**
+ * Helper function:
+ * checks if the array is sorted accordingly to sort type,
+ * using compare function from sort_bus_lines.c.
+ * Big arrays are split into chunks of adjacent pairs (so every
+ * pair is checked once) and checked in parallel.
+ */
+int is_sorted (BusLine *start, BusLine *end, SortType sort_type)
+{
+  if (end - start < 2)
+  {
+    return 1;
+  }
+  SortedChunk jobs[MAXTHREADS];
+  for (int t = 0; t < MAXTHREADS; ++t)
+  {
+    jobs[t] = (SortedChunk) {{0, 0}, start, sort_type, 1};
+  }
+  size_t count = run_chunks ((size_t) (end - start) - 1, sizeof (SortedChunk),
+                             is_sorted_chunk, jobs);
+  int sorted = 1;
+  for (size_t t = 0; t < count; ++t)
+  {
+    sorted = sorted && jobs[t].sorted;
+  }
+  return sorted;
+}
+
 /**
  * Test function:
  * checks if the array is sorted by DISTANCE using quick sort
@@ -42,19 +121,135 @@ int is_sorted_by_duration (BusLine *start, BusLine *end)
 
 /**
  * Test function:
- * checks if the array is sorted by NAME using bubble sort
+ * checks if the array is sorted by NAME using tim sort, which stays
+ * O(n log n) on the many equal names where quick sort degrades
  */
 int is_sorted_by_name (BusLine *start, BusLine *end)
 {
-  bubble_sort (start, end);
-  for (BusLine *i = start; i < end - 1; ++i)
+  tim_sort (start, end - 1, NAME);
+  return is_sorted (start, end, NAME);
+}
+
+/**
+ * Helper function:
+ * true if the list iterates in the order of its copy and every
+ * expected line can be removed from it exactly once
+ */
+static int skiplist_holds (BusLineSkipList *list, BusLine *copy,
+                           BusLine *expected, size_t count)
+{
+  size_t i = 0;
+  for (const SkipNode *node = skiplist_first (list); node != NULL;
+       node = skiplist_next (node))
   {
-    if (strcmp (i->name, (i + 1)->name) > 0)
+    if (i == count || memcmp (&node->line, copy + i++, sizeof (BusLine)))
     {
       return 0;
     }
   }
-  return 1;
+  for (i = 0; i < count; ++i)
+  {
+    if (skiplist_remove (list, expected + i))
+    {
+      return 0;
+    }
+  }
+  return list->size == 0;
+}
+
+/**
+ * Test function:
+ * streams the lines through a skip list ordered by the sort type:
+ * inserts all of them, removes every other one and updates the rest
+ * (distance and duration swapped), then checks that the list is sorted
+ * and holds exactly the expected lines
+ */
+int is_sorted_after_updates (BusLine *start, BusLine *end,
+                             SortType sort_type)
+{
+  size_t num_lines = (size_t) (end - start) + 1;
+  BusLine *expected = malloc (num_lines * sizeof (BusLine));
+  BusLine *copy = malloc (num_lines * sizeof (BusLine));
+  BusLineSkipList list;
+  int sorted = expected != NULL && copy != NULL
+               && skiplist_init (&list, sort_type) == EXIT_SUCCESS;
+  if (!sorted)
+  {
+    free (expected);
+    free (copy);
+    return 0;
+  }
+  for (size_t i = 0; sorted && i < num_lines; ++i)
+  {
+    sorted = skiplist_insert (&list, start + i) == EXIT_SUCCESS;
+  }
+  size_t count = 0;
+  for (size_t i = 0; sorted && i < num_lines; ++i)
+  {
+    if (i % 2 == 1)
+    {
+      sorted = skiplist_remove (&list, start + i) == EXIT_SUCCESS;
+      continue;
+    }
+    expected[count] = start[i];
+    expected[count].distance = start[i].duration;
+    expected[count].duration = start[i].distance;
+    sorted = skiplist_update (&list, start + i, expected + count)
+             == EXIT_SUCCESS;
+    count++;
+  }
+  sorted = sorted && list.size == count
+           && skiplist_copy (&list, copy) == count
+           && is_sorted (copy, copy + count, sort_type)
+           && skiplist_holds (&list, copy, expected, count);
+  skiplist_free (&list);
+  free (expected);
+  free (copy);
+  return sorted;
+}
+
+/**
+ * Helper function:
+ * finds the slot of the name in the open addressing table,
+ * or the empty slot where it should be inserted
+ */
+static NameCount *find_name (const NameTable *table, const char *name,
+                             size_t hash)
+{
+  size_t mask = table->capacity - 1;
+  size_t slot = hash & mask;
+  while (table->slots[slot].used
+         && (table->slots[slot].hash != hash
+             || strcmp (table->slots[slot].name, name) != 0))
+  {
+    slot = (slot + 1) & mask;
+  }
+  return table->slots + slot;
+}
+
+/**
+ * Helper function:
+ * doubles the table and reinserts the names
+ */
+static int grow_table (NameTable *table)
+{
+  NameTable bigger = {calloc (2 * table->capacity, sizeof (NameCount)),
+                      2 * table->capacity, table->size};
+  if (bigger.slots == NULL)
+  {
+    return EXIT_FAILURE;
+  }
+  for (size_t i = 0; i < table->capacity; ++i)
+  {
+    if (table->slots[i].used)
+    {
+      *find_name (&bigger, table->slots[i].name,
+                  table->slots[i].hash) = table->slots[i];
+    }
+  }
+  free (table->slots);
+  *table = bigger;
+  return EXIT_SUCCESS;
 }
 
 /**
@@ -63,9 +258,11 @@ int is_sorted_by_name (BusLine *start, BusLine *end)
  * The definition of array that changed
  * is that the NAMES of the bus lines changed
  * (the duration and distance can change
- * and that does not interest us in this particular function)
+ * and that does not interest us in this particular function).
+ * The names are compared as multisets in O(n): every sorted name
+ * adds one to its count in a hash table, every original name
+ * removes one, and the arrays are equal if nothing is left over.
  */
-
 int is_equal (BusLine *start_sorted, BusLine *end_sorted,
               BusLine *start_original, BusLine *end_original)
 {
@@ -73,41 +270,43 @@ int is_equal (BusLine *start_sorted, BusLine *end_sorted,
   {
     return 0;  // Arrays have different lengths
   }
-  int *name_counts_sorted = (int *) calloc (
-      end_sorted - start_sorted, sizeof (int));
+  NameTable table = {calloc (MINTABLESIZE, sizeof (NameCount)),
+                     MINTABLESIZE, 0};
+  if (table.slots == NULL)
+  {
+    return 0;
+  }
 
   for (BusLine *sorted = start_sorted; sorted < end_sorted; sorted++)
   {
-    for (BusLine *original = start_original;
-         original < end_original; original++)
+    size_t hash = (size_t) hash_name (sorted->name);
+    NameCount *entry = find_name (&table, sorted->name, hash);
+    if (!entry->used)
     {
-      if (name_counts_sorted[sorted - start_sorted] == 0
-          && strcmp (sorted->name, original->name) == 0)
+      if (2 * (table.size + 1) > table.capacity)
       {
-        // Match found, increment count and break
-        name_counts_sorted[sorted - start_sorted]++;
-        break;
+        if (grow_table (&table))
+        {
+          free (table.slots);
+          return 0;
+        }
+        entry = find_name (&table, sorted->name, hash);
       }
+      *entry = (NameCount) {hash, 0, 1, {0}};
+      strcpy (entry->name, sorted->name);
+      table.size++;
     }
+    entry->count++;
   }
-  for (BusLine *original = start_original; original < end_original; original++)
+  int equal = 1;
+  for (BusLine *original = start_original;
+       equal && original < end_original; original++)
   {
-    int count = 0;
-    for (BusLine *sorted = start_sorted; sorted < end_sorted; sorted++)
-    {
-      if (strcmp (sorted->name, original->name) == 0)
-      {
-        count++;
-      }
-    }
-
-    if (count != name_counts_sorted[original - start_original])
-    {
-      free (name_counts_sorted);
-      return 0;
-    }
+    NameCount *entry = find_name (&table, original->name,
+                                  (size_t) hash_name (original->name));
+    equal = entry->used && entry->count-- > 0;
   }
 
-  free (name_counts_sorted);
-  return 1;
-}
\ No newline at end of file
+  free (table.slots);
+  return equal;
+}
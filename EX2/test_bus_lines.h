@@ -12,6 +12,9 @@ int is_sorted_by_duration (BusLine *start, BusLine *end);
 
 int is_sorted_by_name (BusLine *start, BusLine *end);
 
+int is_sorted_after_updates (BusLine *start, BusLine *end,
+                             SortType sort_type);
+
 int is_equal (BusLine *start_sorted,
               BusLine *end_sorted, BusLine *start_original,
               BusLine *end_original);
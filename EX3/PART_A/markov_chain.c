@@ -24,7 +24,7 @@ int get_random_number (int max_number) {
  */
 MarkovNode *create_new_node (char *data_ptr) {
   // copy the data_ptr
-  char *data_cpy = calloc (1, MAXWORDLEN + 1);
+  char *data_cpy = calloc (1, strlen (data_ptr) + 1);
   if (data_cpy == NULL) {
     fprintf (stdout, ALLOCATION_ERROR_MESSAGE);
     free (data_cpy);  // unsuccessful allocation
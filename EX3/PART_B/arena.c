@@ -0,0 +1,112 @@
+#include "arena.h"
+#include <stdint.h> // For uintptr_t
+#include <stdlib.h> // For malloc(), free()
+#include <string.h> // For memset(), memcpy()
+
+/**
+ * Offset of the first byte aligned to alignment at or after data + used
+ * @param chunk
+ * @param alignment
+ * @return
+ */
+static size_t aligned_offset (const ArenaChunk *chunk, size_t alignment) {
+  uintptr_t address = (uintptr_t) (chunk->data + chunk->used);
+  uintptr_t padding = (alignment - address % alignment) % alignment;
+  return chunk->used + (size_t) padding;
+}
+
+/**
+ * Add a chunk of at least size usable bytes in front of the chunk list
+ * @param arena
+ * @param size
+ * @return the new chunk, NULL in case of allocation error
+ */
+static ArenaChunk *add_chunk (Arena *arena, size_t size) {
+  size_t chunk_size = size + ARENA_ALIGNMENT > arena->chunk_size
+                      ? size + ARENA_ALIGNMENT : arena->chunk_size;
+  ArenaChunk *chunk = malloc (sizeof (ArenaChunk) + chunk_size);
+  if (chunk == NULL) {
+    return NULL;
+  }
+  chunk->next = arena->chunks;
+  chunk->size = chunk_size;
+  chunk->used = 0;
+  chunk->data = (char *) (chunk + 1);
+  arena->chunks = chunk;
+  return chunk;
+}
+
+Arena *arena_create (size_t chunk_size) {
+  Arena *arena = malloc (sizeof (Arena));
+  if (arena == NULL) {
+    return NULL;
+  }
+  arena->chunks = NULL;
+  arena->chunk_size = chunk_size;
+  return arena;
+}
+
+/**
+ * Bump size bytes aligned to alignment off the current chunk, adding
+ * a chunk if it has no room
+ * @param arena
+ * @param size
+ * @param alignment
+ * @return the memory, NULL in case of allocation error
+ */
+static void *bump (Arena *arena, size_t size, size_t alignment) {
+  ArenaChunk *chunk = arena->chunks;
+  if (chunk == NULL
+      || aligned_offset (chunk, alignment) + size > chunk->size) {
+    chunk = add_chunk (arena, size);
+    if (chunk == NULL) {
+      return NULL;
+    }
+  }
+  size_t offset = aligned_offset (chunk, alignment);
+  chunk->used = offset + size;
+  return chunk->data + offset;
+}
+
+void *arena_calloc (Arena *arena, size_t size) {
+  void *memory = bump (arena, size, ARENA_ALIGNMENT);
+  if (memory != NULL) {
+    memset (memory, 0, size);
+  }
+  return memory;
+}
+
+void *arena_alloc_bytes (Arena *arena, size_t size) {
+  return bump (arena, size, 1);
+}
+
+void *arena_grow (Arena *arena, void *ptr, size_t old_size, size_t new_size) {
+  ArenaChunk *chunk = arena->chunks;
+  if (ptr != NULL && chunk != NULL
+      && (char *) ptr + old_size == chunk->data + chunk->used
+      && (size_t) ((char *) ptr - chunk->data) + new_size <= chunk->size) {
+    if (new_size > old_size) {
+      memset ((char *) ptr + old_size, 0, new_size - old_size);
+    }
+    chunk->used = (size_t) ((char *) ptr - chunk->data) + new_size;
+    return ptr;
+  }
+  void *grown = arena_calloc (arena, new_size);
+  if (grown != NULL && ptr != NULL) {
+    memcpy (grown, ptr, old_size < new_size ? old_size : new_size);
+  }
+  return grown;
+}
+
+void arena_destroy (Arena *arena) {
+  if (arena == NULL) {
+    return;
+  }
+  ArenaChunk *chunk = arena->chunks;
+  while (chunk != NULL) {
+    ArenaChunk *next = chunk->next;
+    free (chunk);
+    chunk = next;
+  }
+  free (arena);
+}
@@ -0,0 +1,70 @@
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <stddef.h> // For size_t
+
+#define ARENA_ALIGNMENT 16
+#define ARENA_CHUNK_SIZE (1 << 20)
+
+/**
+ * One block of memory of the arena, allocations are bumped from data
+ */
+typedef struct ArenaChunk {
+    struct ArenaChunk *next;
+    size_t size;
+    size_t used;
+    char *data;
+} ArenaChunk;
+
+/**
+ * Bump allocator: memory is taken from big chunks and only released
+ * all at once, when the arena is destroyed
+ */
+typedef struct Arena {
+    ArenaChunk *chunks;
+    size_t chunk_size;
+} Arena;
+
+/**
+ * Create an empty arena that grows by chunks of chunk_size bytes.
+ * @param chunk_size
+ * @return the arena, NULL in case of allocation error
+ */
+Arena *arena_create (size_t chunk_size);
+
+/**
+ * Allocate zeroed memory from the arena, aligned to ARENA_ALIGNMENT.
+ * @param arena
+ * @param size
+ * @return the memory, NULL in case of allocation error
+ */
+void *arena_calloc (Arena *arena, size_t size);
+
+/**
+ * Allocate size bytes from the arena without alignment or zeroing, for
+ * character data packed back to back.
+ * @param arena
+ * @param size
+ * @return the memory, NULL in case of allocation error
+ */
+void *arena_alloc_bytes (Arena *arena, size_t size);
+
+/**
+ * Resize memory of the arena. The last allocation grows in place when
+ * its chunk has room, otherwise it is copied to a new allocation (the
+ * old one is only released with the arena).
+ * @param arena
+ * @param ptr memory from arena_calloc, or NULL
+ * @param old_size the current size of ptr
+ * @param new_size
+ * @return the memory, NULL in case of allocation error
+ */
+void *arena_grow (Arena *arena, void *ptr, size_t old_size, size_t new_size);
+
+/**
+ * Free every chunk of the arena and the arena itself, O(chunks).
+ * @param arena
+ */
+void arena_destroy (Arena *arena);
+
+#endif //_ARENA_H_
@@ -0,0 +1,139 @@
+#include "context_table.h"
+#include <stdlib.h> // For malloc(), free()
+#include <string.h> // For memcmp(), memcpy()
+
+#define MIN_TABLE_CAPACITY 1024
+#define TABLE_CHUNK_SIZE (1 << 20)
+#define SLOT_HASH_MULTIPLIER 0x9e3779b97f4a7c15ULL
+
+/**
+ * Pool hash of the pool ids of the words
+ * @param words
+ * @param order
+ * @return
+ */
+static uint32_t hash_words (const char *const *words, int order) {
+  uint32_t hash = POOL_HASH_SEED;
+  for (int i = 0; i < order; ++i) {
+    uint32_t id = pool_id (words[i]);
+    hash = pool_hash (hash, &id, sizeof (id));
+  }
+  return hash;
+}
+
+/**
+ * Find the slot of the words in the hash set, or the empty slot where
+ * they belong. Interned words are equal exactly when their pointers are.
+ * @param table
+ * @param words
+ * @param hash
+ * @return
+ */
+static ContextSlot *find_slot (const ContextTable *table,
+                               const char *const *words, uint32_t hash) {
+  uint32_t mask = table->slots_capacity - 1;
+  // FNV mixes the ids poorly into the low bits, the slot comes from the
+  // high bits of a multiplicative hash
+  uint32_t i = (uint32_t) ((hash * SLOT_HASH_MULTIPLIER) >> 32) & mask;
+  while (table->slots[i].id != 0 &&
+         (table->slots[i].hash != hash ||
+          memcmp (table->contexts[table->slots[i].id - 1]->words, words,
+                  table->order * sizeof (const char *)) != 0)) {
+    i = (i + 1) & mask;
+  }
+  return &table->slots[i];
+}
+
+/**
+ * Make room for one more context: the list doubles when full and the
+ * hash set doubles and is rebuilt when half full
+ * @param table
+ * @return 0 on success, 1 in case of allocation error
+ */
+static int reserve_context (ContextTable *table) {
+  if (table->size == table->capacity) {
+    uint32_t capacity = 2 * table->capacity;
+    const Context **contexts = realloc (table->contexts,
+                                        capacity * sizeof (const Context *));
+    if (contexts == NULL) {
+      return 1;
+    }
+    table->contexts = contexts;
+    table->capacity = capacity;
+  }
+  if (2 * (table->size + 1) > table->slots_capacity) {
+    uint32_t capacity = 2 * table->slots_capacity;
+    ContextSlot *slots = calloc (capacity, sizeof (ContextSlot));
+    if (slots == NULL) {
+      return 1;
+    }
+    ContextSlot *old = table->slots;
+    uint32_t old_capacity = table->slots_capacity;
+    table->slots = slots;
+    table->slots_capacity = capacity;
+    for (uint32_t i = 0; i < old_capacity; ++i) {
+      if (old[i].id != 0) {
+        *find_slot (table, table->contexts[old[i].id - 1]->words,
+                    old[i].hash) = old[i];
+      }
+    }
+    free (old);
+  }
+  return 0;
+}
+
+ContextTable *context_table_create (int order) {
+  ContextTable *table = calloc (1, sizeof (ContextTable));
+  if (table == NULL) {
+    return NULL;
+  }
+  table->order = order;
+  table->arena = arena_create (TABLE_CHUNK_SIZE);
+  table->contexts = malloc (MIN_TABLE_CAPACITY * sizeof (const Context *));
+  table->slots = calloc (2 * MIN_TABLE_CAPACITY, sizeof (ContextSlot));
+  table->capacity = MIN_TABLE_CAPACITY;
+  table->slots_capacity = 2 * MIN_TABLE_CAPACITY;
+  if (table->arena == NULL || table->contexts == NULL
+      || table->slots == NULL) {
+    context_table_destroy (table);
+    return NULL;
+  }
+  return table;
+}
+
+const Context *context_intern (ContextTable *table,
+                               const char *const *words) {
+  uint32_t hash = hash_words (words, table->order);
+  ContextSlot *slot = find_slot (table, words, hash);
+  if (slot->id != 0) {
+    return table->contexts[slot->id - 1];
+  }
+  uint32_t slots_capacity = table->slots_capacity;
+  if (table->size == POOL_INVALID_ID - 1 || reserve_context (table)) {
+    return NULL;
+  }
+  if (table->slots_capacity != slots_capacity) {
+    slot = find_slot (table, words, hash);
+  }
+  Context *context = arena_calloc (table->arena, sizeof (Context)
+                                   + table->order * sizeof (const char *));
+  if (context == NULL) {
+    return NULL;
+  }
+  context->id = table->size++;
+  context->order = (uint32_t) table->order;
+  memcpy (context->words, words, table->order * sizeof (const char *));
+  table->contexts[context->id] = context;
+  *slot = (ContextSlot) {hash, context->id + 1};
+  return context;
+}
+
+void context_table_destroy (ContextTable *table) {
+  if (table == NULL) {
+    return;
+  }
+  arena_destroy (table->arena);
+  free (table->contexts);
+  free (table->slots);
+  free (table);
+}
@@ -0,0 +1,67 @@
+#ifndef _CONTEXT_TABLE_H_
+#define _CONTEXT_TABLE_H_
+
+#include <stdint.h> // For uint32_t
+#include "arena.h"
+#include "string_pool.h"
+
+/**
+ * A sequence of order interned words, the state of an order-k chain.
+ * Contexts are keyed by the pool ids of their words, and keep the
+ * interned words themselves so they can be printed without the pool.
+ */
+typedef struct Context {
+    uint32_t id;
+    uint32_t order;
+    const char *words[];
+} Context;
+
+/**
+ * Slot of the hash set of a table: the hash and id + 1 of a context, or
+ * an id of 0 if the slot is empty
+ */
+typedef struct ContextSlot {
+    uint32_t hash;
+    uint32_t id;
+} ContextSlot;
+
+/**
+ * Interned contexts: every distinct sequence of words is stored once, in
+ * the table's arena, and has a dense 32-bit id. Interning the same words
+ * twice returns the same context.
+ */
+typedef struct ContextTable {
+    Arena *arena;
+    int order;
+    // contexts[id] is the interned context
+    const Context **contexts;
+    uint32_t size;
+    uint32_t capacity;
+    // open addressing hash set, a probe only follows a context whose hash
+    // matches the one kept in the slot
+    ContextSlot *slots;
+    uint32_t slots_capacity;
+} ContextTable;
+
+/**
+ * Create an empty table of contexts of order words.
+ * @param order
+ * @return the table, NULL in case of allocation error
+ */
+ContextTable *context_table_create (int order);
+
+/**
+ * Intern a context.
+ * @param table
+ * @param words order words interned in a StringPool
+ * @return the interned context, NULL in case of allocation error
+ */
+const Context *context_intern (ContextTable *table, const char *const *words);
+
+/**
+ * Free the table and all its contexts.
+ * @param table
+ */
+void context_table_destroy (ContextTable *table);
+
+#endif //_CONTEXT_TABLE_H_
@@ -23,4 +23,13 @@ typedef struct LinkedList
  */
 int add (LinkedList *link_list, void *data);
 
+/**
+ * Add data at the end of the given link list, using new_node (allocated
+ * by the caller) as its node.
+ * @param link_list Link list to add data to
+ * @param new_node the node to append
+ * @param data pointer to dynamically allocated data
+ */
+void add_node (LinkedList *link_list, Node *new_node, void *data);
+
 #endif //_LINKEDLIST_H_
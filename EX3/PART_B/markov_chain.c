@@ -5,6 +5,12 @@
 #include <stdbool.h> // for bool
 #include <string.h>
 
+#define MIN_INDEX_CAPACITY 64
+#define MIN_START_STATES_CAPACITY 64
+#define MIN_SUCCESSOR_SLOTS 16
+#define LINEAR_SUCCESSORS 8
+#define POINTER_HASH_MULTIPLIER 0x9e3779b97f4a7c15ULL
+
 /**
  * Function that randomizes a number
  * @param max_number
@@ -14,6 +20,46 @@ int get_random_number (int max_number) {
   return rand () % max_number;
 }
 
+/**
+ * Allocate zeroed memory for the chain, from its arena if it has one
+ * @param markov_chain
+ * @param size
+ * @return the memory, NULL in case of allocation error
+ */
+static void *chain_calloc (const MarkovChain *markov_chain, size_t size) {
+  if (markov_chain->arena != NULL) {
+    return arena_calloc (markov_chain->arena, size);
+  }
+  return calloc (1, size);
+}
+
+/**
+ * Resize memory of the chain, from its arena if it has one
+ * @param markov_chain
+ * @param ptr
+ * @param old_size
+ * @param new_size
+ * @return the memory, NULL in case of allocation error
+ */
+static void *chain_grow (const MarkovChain *markov_chain, void *ptr,
+                         size_t old_size, size_t new_size) {
+  if (markov_chain->arena != NULL) {
+    return arena_grow (markov_chain->arena, ptr, old_size, new_size);
+  }
+  return realloc (ptr, new_size);
+}
+
+/**
+ * Free memory of the chain, memory of the arena is only freed with it
+ * @param markov_chain
+ * @param ptr
+ */
+static void chain_free (const MarkovChain *markov_chain, void *ptr) {
+  if (markov_chain->arena == NULL) {
+    free (ptr);
+  }
+}
+
 /**
  * TODO: write func description
  * @param markov_chain
@@ -24,9 +70,11 @@ MarkovNode *create_new_node (MarkovChain *markov_chain, gen_data data_ptr) {
 //  gen_data data_cpy = calloc (1, MAXWORDLEN + 1);
   gen_data data_cpy = markov_chain->copy_func (data_ptr);
   if (data_cpy == NULL) {
-    markov_chain->free_data (data_cpy);
+    fprintf (stdout, ALLOCATION_ERROR_MESSAGE);
+    return NULL;
   }
-  MarkovNode *new_node = calloc (1, sizeof (struct MarkovNode));
+  MarkovNode *new_node = chain_calloc (markov_chain,
+                                       sizeof (struct MarkovNode));
   if (new_node == NULL) {
     fprintf (stdout, ALLOCATION_ERROR_MESSAGE);
     free (new_node);  // unsuccessful allocation
@@ -36,30 +84,28 @@ MarkovNode *create_new_node (MarkovChain *markov_chain, gen_data data_ptr) {
   new_node->data = data_cpy;
   new_node->frequencies_list = NULL;
   new_node->frequencies_list_len = 0;
+  new_node->frequencies_list_cap = 0;
+  new_node->successor_slots = NULL;
+  new_node->successor_slots_cap = 0;
+  new_node->alias_table = NULL;
+  new_node->alias_total = 0;
   return new_node;
 }
 
 /**
  * Get one random state from the given markov_chain's database.
+ * A single draw from the start states.
  * @param markov_chain
- * @return
+ * @return the state, or NULL if no state can start a sequence (e.g. an
+ * empty database or one made only of last states)
  */
 MarkovNode *get_first_random_node (MarkovChain
                                    *markov_chain) {
-  Node *curr;
-  while (true) {
-    curr = markov_chain->database->first;
-    int r = get_random_number (markov_chain->database->size);
-//    r %= markov_chain->database->size;
-    for (int i = 0; i < r; i++) {
-      curr = curr->next;
-    }
-    if (!((curr->data->frequencies_list == NULL) || (markov_chain->is_last
-        (curr->data->data)))) {
-      break;
-    }
+  if (markov_chain->start_states_len == 0) {
+    return NULL;
   }
-  return curr->data;
+  return markov_chain->start_states[get_random_number
+      (markov_chain->start_states_len)];
 }
 
 /**
@@ -81,6 +127,14 @@ int count_occurrences (MarkovNode *node) {
  * @return MarkovNode of the chosen state
  */
 MarkovNode *get_next_random_node (MarkovNode *state_struct_ptr) {
+  if (state_struct_ptr->alias_table != NULL) {
+    int column = get_random_number (state_struct_ptr->frequencies_list_len);
+    int r = get_random_number (state_struct_ptr->alias_total);
+    if (r >= state_struct_ptr->alias_table[column].threshold) {
+      column = state_struct_ptr->alias_table[column].alias;
+    }
+    return state_struct_ptr->frequencies_list[column].markov_node;
+  }
   int occ = count_occurrences (state_struct_ptr);
   int r = get_random_number (occ);
   int i = -1;
@@ -95,13 +149,98 @@ MarkovNode *get_next_random_node (MarkovNode *state_struct_ptr) {
   return state_struct_ptr->frequencies_list[i].markov_node;
 }
 
+/**
+ * Build the alias table of one state with Vose's method, in integers:
+ * every successor i gets weight frequency * len against a column
+ * height of total, so the draws follow the frequencies exactly
+ * @param markov_chain the chain of the state
+ * @param node the state
+ * @param weights scratch array of at least frequencies_list_len
+ * @param stack scratch array of at least frequencies_list_len
+ * @return true on success, false in case of allocation error
+ */
+static bool build_alias_table (MarkovChain *markov_chain, MarkovNode *node,
+                               long long *weights, int *stack) {
+  int len = node->frequencies_list_len;
+  AliasEntry *table = chain_calloc (markov_chain, len * sizeof (AliasEntry));
+  if (table == NULL) {
+    return false;
+  }
+  long long total = count_occurrences (node);
+  // small columns are pushed from the bottom of stack, large from the top
+  int small = 0, large = len;
+  for (int i = 0; i < len; ++i) {
+    weights[i] = (long long) node->frequencies_list[i].frequency * len;
+    if (weights[i] < total) {
+      stack[small++] = i;
+    }
+    else {
+      stack[--large] = i;
+    }
+  }
+  while (small > 0 && large < len) {
+    int s = stack[--small];
+    int l = stack[large++];
+    table[s] = (AliasEntry) {(int) weights[s], l};
+    weights[l] -= total - weights[s];
+    if (weights[l] < total) {
+      stack[small++] = l;
+    }
+    else {
+      stack[--large] = l;
+    }
+  }
+  while (small > 0) {
+    int s = stack[--small];
+    table[s] = (AliasEntry) {(int) total, s};
+  }
+  while (large < len) {
+    int l = stack[large++];
+    table[l] = (AliasEntry) {(int) total, l};
+  }
+  chain_free (markov_chain, node->alias_table);
+  node->alias_table = table;
+  node->alias_total = (int) total;
+  return true;
+}
+
+/**
+ * Build the alias table of every state, so get_next_random_node draws
+ * in O(1). Call after the database is filled, a state that gets new
+ * counts falls back to the frequency list until frozen again.
+ * @param markov_chain
+ * @return true on success, false in case of allocation error
+ */
+bool freeze_markov_chain (MarkovChain *markov_chain) {
+  int max_len = 0;
+  for (Node *curr = markov_chain->database->first; curr != NULL;
+       curr = curr->next) {
+    if (curr->data->frequencies_list_len > max_len) {
+      max_len = curr->data->frequencies_list_len;
+    }
+  }
+  long long *weights = malloc ((max_len + 1) * sizeof (long long));
+  int *stack = malloc ((max_len + 1) * sizeof (int));
+  bool result = weights != NULL && stack != NULL;
+  for (Node *curr = markov_chain->database->first; result && curr != NULL;
+       curr = curr->next) {
+    if (curr->data->frequencies_list_len > 0) {
+      result = build_alias_table (markov_chain, curr->data, weights, stack);
+    }
+  }
+  free (weights);
+  free (stack);
+  return result;
+}
+
 /**
  * Receive markov_chain, generate and print random sentence out of it. The
  * sentence most have at least 2 words in it.
  * @param markov_chain
  * @param first_node markov_node to start with, if NULL- choose a random
  * markov_node
- * @param  max_length maximum length of chain to generate
+ * @param  max_length maximum length of chain to generate, counted in items
+ * beyond the first one so that it does not depend on the order
  */
 void generate_random_sequence (MarkovChain *markov_chain, MarkovNode *
 first_node, int max_length) {
@@ -109,15 +248,23 @@ first_node, int max_length) {
   if (node == NULL) {
     node = get_first_random_node (markov_chain);
   }
-  int i = 0;
+  if (node == NULL) {
+    return;
+  }
+  // the first state prints all of its items, every next one only its last
+  gen_print print = markov_chain->print_func;
+  int i = markov_chain->order > 1 ? markov_chain->order - 1 : 0;
   while (true) {
-    markov_chain->print_func (node->data);
+    print (node->data);
     if ((node->frequencies_list == NULL) || (markov_chain->is_last
-        (node->data)) || (i == max_length)) {
+        (node->data)) || (i >= max_length)) {
       break;
     }
     ++i;
     node = get_next_random_node (node);
+    if (markov_chain->print_step_func != NULL) {
+      print = markov_chain->print_step_func;
+    }
   }
 }
 
@@ -128,45 +275,162 @@ first_node, int max_length) {
 void free_markov_chain (MarkovChain **markov_chain) {
   // initialize the parameters to go over the chain
   MarkovChain *chain = *markov_chain;
+  if (chain == NULL) {
+    return;
+  }
   Node *current = chain->database->first;
   Node *next = NULL;
   int size = chain->database->size;
+  // with an arena only the data is left to free, and maybe not even that
+  if (chain->arena != NULL && chain->free_data == NULL) {
+    size = 0;
+  }
   // start going over the Markov chain
   for (int i = 0; i < size; ++i) {
     next = current->next;
-    free (current->data->data); // free the data field of MarkovNode
+    if (chain->free_data != NULL) {
+      chain->free_data (current->data->data); // free the data of MarkovNode
+    }
     current->data->data = NULL;
-    free (current->data->frequencies_list); // free the freq list
+    chain_free (chain, current->data->frequencies_list); // free freq list
     current->data->frequencies_list = NULL;
-    free (current->data); // free the data field of the Node
+    chain_free (chain, current->data->alias_table); // free the alias table
+    current->data->alias_table = NULL;
+    chain_free (chain, current->data->successor_slots); // free successor map
+    current->data->successor_slots = NULL;
+    chain_free (chain, current->data); // free the data field of the Node
     current->data = NULL;
-    free (current);  // free the current Node
+    chain_free (chain, current);  // free the current Node
     current = next;
   }
+  arena_destroy (chain->arena); // free everything allocated from the arena
+  chain->arena = NULL;
+  free (chain->start_states); // free the start states array
+  chain->start_states = NULL;
+  free (chain->index); // free the hash index of the database
+  chain->index = NULL;
   free (chain->database); // free the LinkedList database
   chain->database = NULL;
   free (chain); // free the chain itself
   chain = NULL;
   *markov_chain = NULL;  // remove the pointer to the chain
+}
 
+/**
+ * Hash of a state by its address
+ * @param node
+ * @return
+ */
+static size_t hash_successor (const MarkovNode *node) {
+  unsigned long long hash = (unsigned long long) (size_t) node;
+  return (size_t) ((hash * POINTER_HASH_MULTIPLIER) >> 32);
 }
 
 /**
- * TODO: write func description
+ * Find the slot of second_node in the successor map of first_node, or
+ * the empty slot where it belongs
+ * @param first_node node with a successor map
+ * @param second_node
+ * @return the slot
+ */
+static int *find_successor_slot (const MarkovNode *first_node,
+                                 const MarkovNode *second_node) {
+  size_t mask = (size_t) first_node->successor_slots_cap - 1;
+  size_t i = hash_successor (second_node) & mask;
+  while (first_node->successor_slots[i] != 0 &&
+         first_node->frequencies_list[first_node->successor_slots[i] - 1]
+             .markov_node != second_node) {
+    i = (i + 1) & mask;
+  }
+  return &first_node->successor_slots[i];
+}
+
+/**
+ * Index of second_node in the counter list of first_node. Short lists
+ * are scanned, longer ones have a successor map.
  * @param first_node
  * @param second_node
- * @return
+ * @return the index, -1 if second_node is not in the list
  */
-bool counter_list_check (MarkovNode *first_node,
-                         MarkovNode *second_node,
-                         int size) {
-  for (int i = 0; i < size; ++i) {
+static int find_successor (const MarkovNode *first_node,
+                           const MarkovNode *second_node) {
+  if (first_node->successor_slots != NULL) {
+    return *find_successor_slot (first_node, second_node) - 1;
+  }
+  for (int i = 0; i < first_node->frequencies_list_len; ++i) {
     if (first_node->frequencies_list[i].markov_node == second_node) {
-      first_node->frequencies_list[i].frequency += 1;
-      return true;
+      return i;
+    }
+  }
+  return -1;
+}
+
+/**
+ * Make room for one more successor of the node: the counter list
+ * doubles when full, and the successor map (once the list is longer
+ * than LINEAR_SUCCESSORS) doubles and is rebuilt when half full
+ * @param markov_chain
+ * @param node
+ * @return true on success, false in case of allocation error
+ */
+static bool reserve_successor (MarkovChain *markov_chain, MarkovNode *node) {
+  int len = node->frequencies_list_len;
+  if (len == node->frequencies_list_cap) {
+    int capacity = len == 0 ? 1 : 2 * len;
+    NextNodeCounterType temp = chain_grow (
+        markov_chain, node->frequencies_list,
+        len * sizeof (struct NextNodeCounter),
+        capacity * sizeof (struct NextNodeCounter));
+    if (temp == NULL) {
+      return false;
+    }
+    node->frequencies_list = temp;
+    node->frequencies_list_cap = capacity;
+  }
+  if (len + 1 <= LINEAR_SUCCESSORS
+      || 2 * (len + 1) <= node->successor_slots_cap) {
+    return true;
+  }
+  int slots_cap = node->successor_slots_cap == 0
+                  ? MIN_SUCCESSOR_SLOTS : 2 * node->successor_slots_cap;
+  int *slots = chain_calloc (markov_chain, slots_cap * sizeof (int));
+  if (slots == NULL) {
+    return false;
+  }
+  chain_free (markov_chain, node->successor_slots);
+  node->successor_slots = slots;
+  node->successor_slots_cap = slots_cap;
+  for (int i = 0; i < len; ++i) {
+    *find_successor_slot (node, node->frequencies_list[i].markov_node) = i + 1;
+  }
+  return true;
+}
+
+/**
+ * Append a node that just got its first successor to the start states
+ * of the chain, unless it is a last state
+ * @param markov_chain
+ * @param node
+ * @return true on success, false in case of allocation error
+ */
+static bool add_start_state (MarkovChain *markov_chain, MarkovNode *node) {
+  if (markov_chain->is_last (node->data)) {
+    return true;
+  }
+  if (markov_chain->start_states_len == markov_chain->start_states_capacity) {
+    int capacity = markov_chain->start_states_capacity == 0
+                   ? MIN_START_STATES_CAPACITY
+                   : 2 * markov_chain->start_states_capacity;
+    MarkovNode **temp = realloc (markov_chain->start_states,
+                                 capacity * sizeof (MarkovNode *));
+    if (temp == NULL) {
+      return false;
     }
+    markov_chain->start_states = temp;
+    markov_chain->start_states_capacity = capacity;
   }
-  return false;
+  markov_chain->start_states[markov_chain->start_states_len++] = node;
+  return true;
 }
 
 /**
@@ -180,32 +444,103 @@ bool counter_list_check (MarkovNode *first_node,
  */
 bool add_node_to_counter_list (MarkovNode *first_node, MarkovNode
 *second_node, MarkovChain *markov_chain) {
+  return add_weighted_to_counter_list (first_node, second_node, 1,
+                                       markov_chain);
+}
+
+/**
+ * Add weight to the counter of the second markov_node in the counter list
+ * of the first markov_node, adding it to the list if needed. Expected
+ * O(1) time.
+ * @param first_node
+ * @param second_node
+ * @param weight the amount of times second_node followed first_node
+ * @param markov_chain
+ * @return success/failure: true if the process was successful, false if in
+ * case of allocation error.
+ */
+bool add_weighted_to_counter_list (MarkovNode *first_node, MarkovNode
+*second_node, int weight, MarkovChain *markov_chain) {
   if (markov_chain == NULL) {
     return false;
   }
-  int size = first_node->frequencies_list_len;
-  if (counter_list_check (first_node, second_node, size) == true) {
+  // the counts change, the table is stale
+  chain_free (markov_chain, first_node->alias_table);
+  first_node->alias_table = NULL;
+  int index = find_successor (first_node, second_node);
+  if (index >= 0) {
+    first_node->frequencies_list[index].frequency += weight;
     return true;
   }
-  size_t new_size;
-  new_size = (size + 1) * sizeof (struct NextNodeCounter);
-  NextNodeCounterType temp;
-  if (first_node->frequencies_list == NULL) {
-    temp = calloc (1, new_size);
+  if (!reserve_successor (markov_chain, first_node)) {
+    return false;
+  }
+  int size = first_node->frequencies_list_len;
+  first_node->frequencies_list[size].frequency = weight;
+  first_node->frequencies_list[size].markov_node = second_node;
+  first_node->frequencies_list_len++;
+  if (first_node->successor_slots != NULL) {
+    *find_successor_slot (first_node, second_node) = size + 1;
   }
-  else {
-    temp = realloc (first_node->frequencies_list,
-                    new_size);
+  if (size == 0) {
+    return add_start_state (markov_chain, first_node);
+  }
+  return true;
+}
+
+/**
+ * Find the slot of data_ptr in the index of the database, or the empty
+ * slot where it belongs (linear probing)
+ * @param markov_chain chain with a non empty index
+ * @param data_ptr the state to look for
+ * @param hash hash of the state
+ * @return the slot
+ */
+static IndexSlot *find_index_slot (const MarkovChain *markov_chain,
+                                   gen_data data_ptr, size_t hash) {
+  size_t mask = (size_t) markov_chain->index_capacity - 1;
+  size_t i = hash & mask;
+  while (markov_chain->index[i].node != NULL &&
+         (markov_chain->index[i].hash != hash ||
+          markov_chain->comp_func (markov_chain->index[i].node->data->data,
+                                   data_ptr) != 0)) {
+    i = (i + 1) & mask;
   }
-  if (temp == NULL) {
-    free (temp);
-    temp = NULL;
+  return &markov_chain->index[i];
+}
+
+/**
+ * Make sure the index has room for one more node, doubling it and
+ * reinserting the nodes when it would become more than half full
+ * @param markov_chain
+ * @return true on success, false in case of allocation error
+ */
+static bool reserve_index (MarkovChain *markov_chain) {
+  int size = markov_chain->database->size;
+  if (2 * (size + 1) <= markov_chain->index_capacity) {
+    return true;
+  }
+  int capacity = markov_chain->index_capacity == 0 ? MIN_INDEX_CAPACITY
+                                                   : 2 * markov_chain
+                                                       ->index_capacity;
+  IndexSlot *old_index = markov_chain->index;
+  int old_capacity = markov_chain->index_capacity;
+  IndexSlot *index = calloc ((size_t) capacity, sizeof (IndexSlot));
+  if (index == NULL) {
     return false;
   }
-  temp[size].frequency = 1;
-  temp[size].markov_node = second_node;
-  first_node->frequencies_list = temp;
-  first_node->frequencies_list_len++;
+  markov_chain->index = index;
+  markov_chain->index_capacity = capacity;
+  for (int i = 0; i < old_capacity; ++i) {
+    if (old_index[i].node != NULL) {
+      size_t j = old_index[i].hash & (size_t) (capacity - 1);
+      while (index[j].node != NULL) {
+        j = (j + 1) & (size_t) (capacity - 1);
+      }
+      index[j] = old_index[i];
+    }
+  }
+  free (old_index);
   return true;
 }
 
@@ -219,6 +554,10 @@ bool add_node_to_counter_list (MarkovNode *first_node, MarkovNode
  */
 Node *
 get_node_from_database (const MarkovChain *markov_chain, void *data_ptr) {
+  if (markov_chain->hash_func != NULL && markov_chain->index != NULL) {
+    return find_index_slot (markov_chain, data_ptr,
+                            markov_chain->hash_func (data_ptr))->node;
+  }
   Node *current = markov_chain->database->first;
   while (current != NULL) {
     if (markov_chain->comp_func (current->data->data, data_ptr) == 0) {
@@ -229,6 +568,26 @@ get_node_from_database (const MarkovChain *markov_chain, void *data_ptr) {
   return NULL;
 }
 
+/**
+ * Append a new state at the end of the database, with its Node taken
+ * from the arena of the chain if it has one
+ * @param markov_chain
+ * @param new_node the state
+ * @return SUCCESS or FAILURE in case of allocation error
+ */
+static int append_to_database (MarkovChain *markov_chain,
+                               MarkovNode *new_node) {
+  if (markov_chain->arena == NULL) {
+    return add (markov_chain->database, new_node);
+  }
+  Node *node = arena_calloc (markov_chain->arena, sizeof (Node));
+  if (node == NULL) {
+    return FAILURE;
+  }
+  add_node (markov_chain->database, node, new_node);
+  return SUCCESS;
+}
+
 /**
 * If data_ptr in markov_chain, return it's node. Otherwise, create new
  * node, add to end of markov_chain's database and return it.
@@ -241,13 +600,22 @@ Node *add_to_database (MarkovChain *markov_chain, gen_data data_ptr) {
   if (curr != NULL) {
     return curr;
   }
+  if (markov_chain->hash_func != NULL && !reserve_index (markov_chain)) {
+    return NULL;
+  }
   MarkovNode *new_node = create_new_node (markov_chain, data_ptr);
   if (new_node == NULL ||
-  add (markov_chain->database, new_node) == FAILURE) {
+  append_to_database (markov_chain, new_node) == FAILURE) {
     //markov_chain->free_data (new_node->data);
-    free (new_node);
+    chain_free (markov_chain, new_node);
     new_node = NULL;
     return NULL;
   }
+  if (markov_chain->hash_func != NULL) {
+    size_t hash = markov_chain->hash_func (data_ptr);
+    IndexSlot *slot = find_index_slot (markov_chain, data_ptr, hash);
+    slot->hash = hash;
+    slot->node = markov_chain->database->last;
+  }
   return markov_chain->database->last;
-}
\ No newline at end of file
+}
@@ -2,6 +2,7 @@
 #define _MARKOV_CHAIN_H
 
 #include "linked_list.h"
+#include "arena.h"
 #include <stdio.h>  // For printf(), sscanf()
 #include <stdlib.h> // For exit(), malloc()
 #include <stdbool.h> // for bool
@@ -23,6 +24,7 @@ typedef int (*gen_comp) (gen_data, gen_data);
 typedef void (*gen_free) (gen_data);
 typedef gen_data (*gen_cpy) (gen_data);
 typedef bool (*gen_last) (gen_data);
+typedef size_t (*gen_hash) (gen_data);
 /***************************/
 
 
@@ -30,10 +32,26 @@ typedef bool (*gen_last) (gen_data);
 /***************************/
 /*        STRUCTS          */
 /***************************/
+/* column of an alias table: draw r in [0, alias_total), keep the
+ * column's own successor if r < threshold, otherwise take alias */
+typedef struct AliasEntry {
+    int threshold;
+    int alias;
+} AliasEntry;
+
 typedef struct MarkovNode {
     gen_data data;
     NextNodeCounterType frequencies_list;
     int frequencies_list_len;
+    int frequencies_list_cap;
+    // open addressing map from a successor to its index + 1 in
+    // frequencies_list (0 for an empty slot), NULL while the list is short
+    int *successor_slots;
+    int successor_slots_cap;
+    // alias table over frequencies_list, NULL unless the chain is frozen
+    // and the counts did not change since
+    AliasEntry *alias_table;
+    int alias_total;
 } MarkovNode;
 
 typedef struct NextNodeCounter {
@@ -41,7 +59,14 @@ typedef struct NextNodeCounter {
     int frequency;
 } NextNodeCounter;
 
-/* DO NOT ADD or CHANGE variable names in this struct */
+/* slot of the database index, node is NULL if the slot is empty */
+typedef struct IndexSlot {
+    size_t hash;
+    Node *node;
+} IndexSlot;
+
+/* DO NOT CHANGE the original fields (database to is_last), their names or
+ * their order; new fields go after is_last. */
 typedef struct MarkovChain {
     LinkedList *database;
 
@@ -57,7 +82,7 @@ typedef struct MarkovChain {
     gen_comp comp_func;
 
     // a pointer to a function that gets a pointer of generic data type and
-    // frees it.
+    // frees it. May be NULL if the chain does not own its data.
     // returns void.
     gen_free free_data;
 
@@ -71,12 +96,50 @@ typedef struct MarkovChain {
     //      - true if it's the last state.
     //      - false otherwise.
     gen_last is_last;
+
+    // a pointer to a function that gets a pointer of generic data type and
+    // returns its hash. Equal states (comp_func returns 0) must have equal
+    // hashes. If NULL, the database is searched linearly.
+    gen_hash hash_func;
+
+    // open addressing hash index over the nodes of the database, kept
+    // at most half full. Only used when hash_func is set.
+    IndexSlot *index;
+    int index_capacity;
+
+    // the states a sequence may start from: not last and with at least
+    // one successor. Filled by add_node_to_counter_list.
+    MarkovNode **start_states;
+    int start_states_len;
+    int start_states_capacity;
+
+    // if not NULL, the states, their database nodes, successor lists and
+    // alias tables are allocated from this arena, which the chain owns
+    // and frees at once in free_markov_chain.
+    Arena *arena;
+
+    // the amount of items (e.g. words) a state spans, 0 or 1 if every
+    // state is a single item. Consecutive states of an order-k chain
+    // overlap in k - 1 items.
+    int order;
+
+    // a pointer to a func that prints only the last item of a state, used
+    // for every state but the first of a sequence. If NULL, print_func is
+    // used for all of them.
+    gen_print print_step_func;
 } MarkovChain;
 
+/**
+ * Get a random number in [0, max_number) from rand().
+ * @param max_number
+ * @return
+ */
+int get_random_number (int max_number);
+
 /**
  * Get one random state from the given markov_chain's database.
  * @param markov_chain
- * @return
+ * @return the state, or NULL if no state can start a sequence
  */
 MarkovNode *get_first_random_node (MarkovChain *markov_chain);
 
@@ -87,13 +150,23 @@ MarkovNode *get_first_random_node (MarkovChain *markov_chain);
  */
 MarkovNode *get_next_random_node (MarkovNode *state_struct_ptr);
 
+/**
+ * Build the alias table of every state, so get_next_random_node draws
+ * in O(1). Call after the database is filled, a state that gets new
+ * counts falls back to the frequency list until frozen again.
+ * @param markov_chain
+ * @return true on success, false in case of allocation error
+ */
+bool freeze_markov_chain (MarkovChain *markov_chain);
+
 /**
  * Receive markov_chain, generate and print random sentence out of it. The
  * sentence most have at least 2 words in it.
  * @param markov_chain
  * @param first_node markov_node to start with, if NULL- choose a random
- * markov_node
- * @param  max_length maximum length of chain to generate
+ * markov_node. Nothing is printed if there is none to choose.
+ * @param  max_length maximum length of chain to generate, counted in items
+ * beyond the first one so that it does not depend on the order
  */
 void generate_random_sequence (MarkovChain *markov_chain, MarkovNode *
 first_node, int max_length);
@@ -116,6 +189,20 @@ void free_markov_chain (MarkovChain **markov_chain);
 bool add_node_to_counter_list (MarkovNode *first_node, MarkovNode
 *second_node, MarkovChain *markov_chain);
 
+/**
+ * Add weight to the counter of the second markov_node in the counter list
+ * of the first markov_node, adding it to the list if needed. Expected
+ * O(1) time.
+ * @param first_node
+ * @param second_node
+ * @param weight the amount of times second_node followed first_node
+ * @param markov_chain
+ * @return success/failure: true if the process was successful, false if in
+ * case of allocation error.
+ */
+bool add_weighted_to_counter_list (MarkovNode *first_node, MarkovNode
+*second_node, int weight, MarkovChain *markov_chain);
+
 /**
 * Check if data_ptr is in database. If so, return the markov_node wrapping it
  * in the markov_chain, otherwise return NULL.
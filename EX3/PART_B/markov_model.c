@@ -0,0 +1,389 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "markov_model.h"
+#include <fcntl.h> // For open()
+#include <limits.h> // For INT_MAX
+#include <stdint.h> // For uintptr_t
+#include <string.h> // For strlen(), memcpy()
+#include <sys/mman.h> // For mmap(), munmap()
+#include <sys/stat.h> // For fstat()
+#include <unistd.h> // For close()
+
+#define WRITEMODE "wb"
+#define SECTION_ALIGNMENT 8
+
+/**
+ * A state of the chain and its index in the model
+ */
+typedef struct StateRef {
+    const MarkovNode *node;
+    uint32_t index;
+} StateRef;
+
+/**
+ * The sections of a model, built in memory before they are written
+ */
+typedef struct ModelSections {
+    ModelHeader header;
+    char *strings;
+    ModelState *states;
+    ModelSuccessor *successors;
+    uint32_t *starts;
+    StateRef *refs;
+} ModelSections;
+
+static uint64_t align_section (uint64_t offset) {
+  return (offset + SECTION_ALIGNMENT - 1) & ~(uint64_t) (SECTION_ALIGNMENT - 1);
+}
+
+static int compare_refs (const void *a, const void *b) {
+  uintptr_t first = (uintptr_t) ((const StateRef *) a)->node;
+  uintptr_t second = (uintptr_t) ((const StateRef *) b)->node;
+  return (first > second) - (first < second);
+}
+
+/**
+ * Find the index of a state of the chain
+ * @param sections
+ * @param node
+ * @return
+ */
+static uint32_t state_index (const ModelSections *sections,
+                             const MarkovNode *node) {
+  StateRef key = {node, 0};
+  const StateRef *ref = bsearch (&key, sections->refs,
+                                 sections->header.states_len,
+                                 sizeof (StateRef), compare_refs);
+  return ref->index;
+}
+
+static void free_sections (ModelSections *sections) {
+  free (sections->strings);
+  free (sections->states);
+  free (sections->successors);
+  free (sections->starts);
+  free (sections->refs);
+}
+
+/**
+ * Size the sections and lay them out after the header
+ * @param sections
+ * @param markov_chain
+ * @return 0 on success, 1 in case of allocation error
+ */
+static int allocate_sections (ModelSections *sections,
+                              const MarkovChain *markov_chain) {
+  ModelHeader *header = &sections->header;
+  header->magic = MODEL_MAGIC;
+  header->version = MODEL_VERSION;
+  header->states_len = (uint32_t) markov_chain->database->size;
+  header->starts_len = (uint32_t) markov_chain->start_states_len;
+  for (Node *curr = markov_chain->database->first; curr != NULL;
+       curr = curr->next) {
+    header->successors_len += (uint32_t) curr->data->frequencies_list_len;
+    header->strings_size += strlen ((const char *) curr->data->data) + 1;
+  }
+  header->strings_offset = align_section (sizeof (ModelHeader));
+  header->states_offset = align_section (header->strings_offset
+                                         + header->strings_size);
+  header->successors_offset = align_section (
+      header->states_offset + header->states_len * sizeof (ModelState));
+  header->starts_offset = align_section (
+      header->successors_offset
+      + header->successors_len * sizeof (ModelSuccessor));
+
+  sections->strings = malloc (header->strings_size + 1);
+  sections->states = malloc ((header->states_len + 1) * sizeof (ModelState));
+  sections->successors = malloc ((header->successors_len + 1)
+                                 * sizeof (ModelSuccessor));
+  sections->starts = malloc ((header->starts_len + 1) * sizeof (uint32_t));
+  sections->refs = malloc ((header->states_len + 1) * sizeof (StateRef));
+  return sections->strings == NULL || sections->states == NULL
+         || sections->successors == NULL || sections->starts == NULL
+         || sections->refs == NULL;
+}
+
+/**
+ * Fill the sections from the chain
+ * @param sections
+ * @param markov_chain
+ * @return 0 on success, 1 if a state with successors has no alias table
+ */
+static int fill_sections (ModelSections *sections,
+                          const MarkovChain *markov_chain) {
+  uint32_t index = 0;
+  for (Node *curr = markov_chain->database->first; curr != NULL;
+       curr = curr->next) {
+    sections->refs[index] = (StateRef) {curr->data, index};
+    ++index;
+  }
+  qsort (sections->refs, sections->header.states_len, sizeof (StateRef),
+         compare_refs);
+
+  uint32_t word = 0, successor = 0;
+  index = 0;
+  for (Node *curr = markov_chain->database->first; curr != NULL;
+       curr = curr->next) {
+    const MarkovNode *node = curr->data;
+    if (node->frequencies_list_len > 0 && node->alias_table == NULL) {
+      return 1;
+    }
+    size_t len = strlen ((const char *) node->data) + 1;
+    memcpy (sections->strings + word, node->data, len);
+    sections->states[index++] = (ModelState) {
+        word, successor, (uint32_t) node->frequencies_list_len,
+        node->alias_total, markov_chain->is_last (node->data)};
+    word += (uint32_t) len;
+    for (int i = 0; i < node->frequencies_list_len; ++i) {
+      sections->successors[successor++] = (ModelSuccessor) {
+          state_index (sections, node->frequencies_list[i].markov_node),
+          node->alias_table[i].threshold,
+          (uint32_t) node->alias_table[i].alias};
+    }
+  }
+  for (int i = 0; i < markov_chain->start_states_len; ++i) {
+    sections->starts[i] = state_index (sections,
+                                       markov_chain->start_states[i]);
+  }
+  return 0;
+}
+
+/**
+ * Write a section, then zeros up to the offset of the next one
+ * @param file
+ * @param data
+ * @param size
+ * @param next_offset
+ * @return 0 on success, 1 if the file could not be written
+ */
+static int write_section (FILE *file, const void *data, size_t size,
+                          uint64_t next_offset) {
+  static const char padding[SECTION_ALIGNMENT] = {0};
+  if (size > 0 && fwrite (data, 1, size, file) != size) {
+    return 1;
+  }
+  long position = ftell (file);
+  size_t pad = position < 0 ? 0 : (size_t) (next_offset
+                                            - (uint64_t) position);
+  return position < 0 || fwrite (padding, 1, pad, file) != pad;
+}
+
+/**
+ * Write a frozen chain of order 1, whose states are strings, to a model
+ * file.
+ * @param path
+ * @param markov_chain a chain frozen by freeze_markov_chain
+ * @return 0 on success, 1 if the file could not be written, the chain is
+ * not frozen or of a higher order, or in case of allocation error
+ */
+int save_markov_model (const char *path, const MarkovChain *markov_chain) {
+  ModelSections sections;
+  memset (&sections, 0, sizeof (sections));
+  if (markov_chain->order > 1) {
+    return 1;
+  }
+  if (allocate_sections (&sections, markov_chain)
+      || fill_sections (&sections, markov_chain)) {
+    free_sections (&sections);
+    return 1;
+  }
+  const ModelHeader *header = &sections.header;
+  FILE *file = fopen (path, WRITEMODE);
+  if (file == NULL) {
+    free_sections (&sections);
+    return 1;
+  }
+  int result = write_section (file, header, sizeof (ModelHeader),
+                              header->strings_offset)
+               || write_section (file, sections.strings, header->strings_size,
+                                 header->states_offset)
+               || write_section (file, sections.states,
+                                 header->states_len * sizeof (ModelState),
+                                 header->successors_offset)
+               || write_section (file, sections.successors,
+                                 header->successors_len
+                                 * sizeof (ModelSuccessor),
+                                 header->starts_offset)
+               || write_section (file, sections.starts,
+                                 header->starts_len * sizeof (uint32_t),
+                                 header->starts_offset
+                                 + header->starts_len * sizeof (uint32_t));
+  if (fclose (file) != 0) {
+    result = 1;
+  }
+  free_sections (&sections);
+  return result;
+}
+
+/**
+ * Check that len items of item_size bytes starting at offset end by end,
+ * comparing against the room left so that nothing can wrap around
+ * @param offset
+ * @param len
+ * @param item_size
+ * @param end
+ * @return
+ */
+static bool section_fits (uint64_t offset, uint64_t len, size_t item_size,
+                          uint64_t end) {
+  return offset <= end && len <= (end - offset) / item_size;
+}
+
+/**
+ * Check that the sections of the header lie inside the file, in order
+ * @param header
+ * @param size the length of the file
+ * @return
+ */
+static bool header_fits (const ModelHeader *header, size_t size) {
+  return header->version == MODEL_VERSION
+         && header->strings_offset >= sizeof (ModelHeader)
+         && header->strings_size > 0
+         && header->starts_len <= INT_MAX
+         && header->states_offset % SECTION_ALIGNMENT == 0
+         && header->successors_offset % SECTION_ALIGNMENT == 0
+         && header->starts_offset % SECTION_ALIGNMENT == 0
+         && section_fits (header->strings_offset, header->strings_size, 1,
+                          header->states_offset)
+         && section_fits (header->states_offset, header->states_len,
+                          sizeof (ModelState), header->successors_offset)
+         && section_fits (header->successors_offset, header->successors_len,
+                          sizeof (ModelSuccessor), header->starts_offset)
+         && section_fits (header->starts_offset, header->starts_len,
+                          sizeof (uint32_t), size);
+}
+
+/**
+ * Check every index of the sections in one pass: the words lie in the
+ * string table, the states own consecutive runs of columns that cover
+ * the successors section, the columns and start states name existing
+ * states and every state with successors can be drawn from
+ * @param model a model whose header fits the file
+ * @return
+ */
+static bool sections_valid (const MarkovModel *model) {
+  const ModelHeader *header = model->header;
+  uint32_t next = 0;
+  for (uint32_t i = 0; i < header->states_len; ++i) {
+    const ModelState *state = &model->states[i];
+    if (state->word >= header->strings_size || state->successors != next
+        || state->successors_len > header->successors_len - next
+        || state->successors_len > INT_MAX
+        || (state->successors_len > 0 && state->alias_total <= 0)) {
+      return false;
+    }
+    const ModelSuccessor *columns = &model->successors[next];
+    for (uint32_t column = 0; column < state->successors_len; ++column) {
+      if (columns[column].state >= header->states_len
+          || columns[column].alias >= state->successors_len) {
+        return false;
+      }
+    }
+    next += state->successors_len;
+  }
+  if (next != header->successors_len) {
+    return false;
+  }
+  for (uint32_t i = 0; i < header->starts_len; ++i) {
+    if (model->starts[i] >= header->states_len) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Map a model file with a single mmap. The header and every section are
+ * checked once, in O(states + successors), so that generating from the
+ * model never reads outside the mapping.
+ * @param path
+ * @param model set to the mapped model
+ * @return MODEL_OK, MODEL_MISSING if the file could not be opened,
+ * MODEL_NOT_MODEL if it does not start with MODEL_MAGIC or MODEL_INVALID
+ * if its header does not fit the file or its sections are malformed
+ */
+int open_markov_model (const char *path, MarkovModel *model) {
+  memset (model, 0, sizeof (MarkovModel));
+  int fd = open (path, O_RDONLY);
+  if (fd < 0) {
+    return MODEL_MISSING;
+  }
+  struct stat info;
+  if (fstat (fd, &info) != 0) {
+    close (fd);
+    return MODEL_MISSING;
+  }
+  if ((size_t) info.st_size < sizeof (ModelHeader)) {
+    close (fd);
+    return MODEL_NOT_MODEL;
+  }
+  size_t size = (size_t) info.st_size;
+  void *mapping = mmap (NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close (fd);
+  if (mapping == MAP_FAILED) {
+    return MODEL_MISSING;
+  }
+  const ModelHeader *header = mapping;
+  int result = header->magic != MODEL_MAGIC ? MODEL_NOT_MODEL
+               : !header_fits (header, size) ? MODEL_INVALID
+               : ((const char *) mapping)[header->strings_offset
+                                          + header->strings_size - 1] != '\0'
+                 ? MODEL_INVALID : MODEL_OK;
+  if (result != MODEL_OK) {
+    munmap (mapping, size);
+    return result;
+  }
+  const char *base = mapping;
+  model->mapping = mapping;
+  model->mapping_size = size;
+  model->header = header;
+  model->strings = base + header->strings_offset;
+  model->states = (const ModelState *) (base + header->states_offset);
+  model->successors = (const ModelSuccessor *) (base
+                                                + header->successors_offset);
+  model->starts = (const uint32_t *) (base + header->starts_offset);
+  if (!sections_valid (model)) {
+    close_markov_model (model);
+    return MODEL_INVALID;
+  }
+  return MODEL_OK;
+}
+
+/**
+ * Unmap a model
+ * @param model
+ */
+void close_markov_model (MarkovModel *model) {
+  if (model->mapping != NULL) {
+    munmap (model->mapping, model->mapping_size);
+  }
+  memset (model, 0, sizeof (MarkovModel));
+}
+
+/**
+ * Generate and print a random sequence from the model, drawing the same
+ * random numbers as generate_random_sequence does on the frozen chain.
+ * @param model
+ * @param print_func prints a word of the model
+ * @param max_length maximum length of sequence to generate
+ */
+void generate_model_sequence (const MarkovModel *model, gen_print print_func,
+                              int max_length) {
+  if (model->header->starts_len == 0) {
+    return;
+  }
+  const ModelState *state = &model->states[model->starts[get_random_number (
+      (int) model->header->starts_len)]];
+  for (int i = 0;; ++i) {
+    print_func ((gen_data) (model->strings + state->word));
+    if (state->successors_len == 0 || state->is_last || i == max_length) {
+      break;
+    }
+    const ModelSuccessor *columns = &model->successors[state->successors];
+    int column = get_random_number ((int) state->successors_len);
+    if (get_random_number (state->alias_total) >= columns[column].threshold) {
+      column = (int) columns[column].alias;
+    }
+    state = &model->states[columns[column].state];
+  }
+}
@@ -0,0 +1,109 @@
+#ifndef _MARKOV_MODEL_H_
+#define _MARKOV_MODEL_H_
+
+#include <stddef.h> // For size_t
+#include <stdint.h> // For uint32_t, uint64_t
+#include "markov_chain.h"
+
+#define MODEL_MAGIC 0x314d4b4du
+#define MODEL_VERSION 1
+
+#define MODEL_OK 0
+#define MODEL_MISSING 1
+#define MODEL_NOT_MODEL 2
+#define MODEL_INVALID 3
+
+/**
+ * On-disk header of a model file. Every section starts at its offset
+ * from the beginning of the file, aligned to 8 bytes.
+ */
+typedef struct ModelHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t states_len;
+    uint32_t successors_len;
+    uint32_t starts_len;
+    uint32_t reserved;
+    uint64_t strings_offset;
+    uint64_t strings_size;
+    uint64_t states_offset;
+    uint64_t successors_offset;
+    uint64_t starts_offset;
+} ModelHeader;
+
+/**
+ * A state of the model: its word and its columns in the successors
+ * section, in the order of the frequency list
+ */
+typedef struct ModelState {
+    // offset of the NUL terminated word in the string table
+    uint32_t word;
+    uint32_t successors;
+    uint32_t successors_len;
+    int32_t alias_total;
+    uint32_t is_last;
+} ModelState;
+
+/**
+ * A column of the alias table of a state: draw r in [0, alias_total),
+ * take state if r < threshold, otherwise take the column alias
+ */
+typedef struct ModelSuccessor {
+    uint32_t state;
+    int32_t threshold;
+    uint32_t alias;
+} ModelSuccessor;
+
+/**
+ * A model file mapped read only into memory, the sections point into
+ * the mapping
+ */
+typedef struct MarkovModel {
+    void *mapping;
+    size_t mapping_size;
+    const ModelHeader *header;
+    const char *strings;
+    const ModelState *states;
+    const ModelSuccessor *successors;
+    const uint32_t *starts;
+} MarkovModel;
+
+/**
+ * Write a frozen chain of order 1, whose states are strings, to a model
+ * file.
+ * @param path
+ * @param markov_chain a chain frozen by freeze_markov_chain
+ * @return 0 on success, 1 if the file could not be written, the chain is
+ * not frozen or of a higher order, or in case of allocation error
+ */
+int save_markov_model (const char *path, const MarkovChain *markov_chain);
+
+/**
+ * Map a model file with a single mmap. The header and every section are
+ * checked once, in O(states + successors), so that generating from the
+ * model never reads outside the mapping.
+ * @param path
+ * @param model set to the mapped model
+ * @return MODEL_OK, MODEL_MISSING if the file could not be opened,
+ * MODEL_NOT_MODEL if it does not start with MODEL_MAGIC or MODEL_INVALID
+ * if its header does not fit the file or its sections are malformed
+ */
+int open_markov_model (const char *path, MarkovModel *model);
+
+/**
+ * Unmap a model
+ * @param model
+ */
+void close_markov_model (MarkovModel *model);
+
+/**
+ * Generate and print a random sequence from the model, drawing the same
+ * random numbers as generate_random_sequence does on the frozen chain.
+ * @param model
+ * @param print_func prints a word of the model
+ * @param max_length maximum length of sequence to generate
+ */
+void generate_model_sequence (const MarkovModel *model, gen_print print_func,
+                              int max_length);
+
+#endif //_MARKOV_MODEL_H_
@@ -0,0 +1,253 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "shard_ingest.h"
+#include "tokenizer.h"
+#include <pthread.h>
+#include <stdint.h> // For uint32_t, uint64_t
+#include <stdlib.h> // For malloc(), free()
+#include <string.h> // For memchr(), memset()
+#include <unistd.h> // For sysconf()
+
+#define MIN_SHARD_SIZE (1 << 20)
+#define MIN_BIGRAMS 1024
+#define BIGRAM_HASH_MULTIPLIER 0x9e3779b97f4a7c15ULL
+
+/**
+ * A pair of consecutive words of a shard, by their local ids
+ */
+typedef struct Bigram {
+    uint32_t first;
+    uint32_t second;
+    int count;
+} Bigram;
+
+/**
+ * The part of the text one thread reads, and what it learned from it:
+ * the words in order of first appearance (the ids of the local pool)
+ * and the bigrams in order of first appearance
+ */
+typedef struct Shard {
+    const char *start;
+    size_t size;
+    gen_last is_last;
+    StringPool *pool;
+    Bigram *bigrams;
+    uint32_t bigrams_len;
+    uint32_t bigrams_cap;
+    // open addressing map from a bigram to its index + 1, 0 if empty
+    uint32_t *slots;
+    uint32_t slots_cap;
+    int result;
+} Shard;
+
+/**
+ * Find the slot of the bigram (first, second) in the map of the shard,
+ * or the empty slot where it belongs
+ * @param shard
+ * @param first
+ * @param second
+ * @return the slot
+ */
+static uint32_t *find_bigram_slot (const Shard *shard, uint32_t first,
+                                   uint32_t second) {
+  uint64_t key = ((uint64_t) first << 32) | second;
+  uint32_t mask = shard->slots_cap - 1;
+  uint32_t i = (uint32_t) ((key * BIGRAM_HASH_MULTIPLIER) >> 32) & mask;
+  while (shard->slots[i] != 0 &&
+         (shard->bigrams[shard->slots[i] - 1].first != first ||
+          shard->bigrams[shard->slots[i] - 1].second != second)) {
+    i = (i + 1) & mask;
+  }
+  return &shard->slots[i];
+}
+
+/**
+ * Make room for one more bigram: the list doubles when full and the
+ * map doubles and is rebuilt when half full
+ * @param shard
+ * @return 0 on success, 1 in case of allocation error
+ */
+static int reserve_bigram (Shard *shard) {
+  if (shard->bigrams_len == shard->bigrams_cap) {
+    uint32_t capacity = shard->bigrams_cap == 0 ? MIN_BIGRAMS
+                                                : 2 * shard->bigrams_cap;
+    Bigram *bigrams = realloc (shard->bigrams, capacity * sizeof (Bigram));
+    if (bigrams == NULL) {
+      return 1;
+    }
+    shard->bigrams = bigrams;
+    shard->bigrams_cap = capacity;
+  }
+  if (2 * (shard->bigrams_len + 1) > shard->slots_cap) {
+    uint32_t capacity = shard->slots_cap == 0 ? 2 * MIN_BIGRAMS
+                                              : 2 * shard->slots_cap;
+    uint32_t *slots = calloc (capacity, sizeof (uint32_t));
+    if (slots == NULL) {
+      return 1;
+    }
+    free (shard->slots);
+    shard->slots = slots;
+    shard->slots_cap = capacity;
+    for (uint32_t i = 0; i < shard->bigrams_len; ++i) {
+      *find_bigram_slot (shard, shard->bigrams[i].first,
+                         shard->bigrams[i].second) = i + 1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * Count one more occurrence of the bigram (first, second)
+ * @param shard
+ * @param first
+ * @param second
+ * @return 0 on success, 1 in case of allocation error
+ */
+static int count_bigram (Shard *shard, uint32_t first, uint32_t second) {
+  if (shard->slots != NULL) {
+    uint32_t *slot = find_bigram_slot (shard, first, second);
+    if (*slot != 0) {
+      shard->bigrams[*slot - 1].count++;
+      return 0;
+    }
+  }
+  if (reserve_bigram (shard)) {
+    return 1;
+  }
+  shard->bigrams[shard->bigrams_len] = (Bigram) {first, second, 1};
+  *find_bigram_slot (shard, first, second) = ++shard->bigrams_len;
+  return 0;
+}
+
+/**
+ * Thread function: reads the words of the shard, bigrams never cross
+ * the end of a line
+ * @param arg the shard
+ * @return NULL
+ */
+static void *read_shard (void *arg) {
+  Shard *shard = arg;
+  Tokenizer tokenizer;
+  Token token;
+  const char *previous = NULL;
+  shard->result = 0;
+  tokenizer_init (&tokenizer, shard->start, shard->size);
+  while (!shard->result && next_token (&tokenizer, &token)) {
+    const char *interned = pool_intern_n (shard->pool, token.start,
+                                          token.len);
+    if (interned == NULL) {
+      shard->result = 1;
+      break;
+    }
+    if (previous != NULL && !token.new_line
+        && !shard->is_last ((gen_data) previous)) {
+      shard->result = count_bigram (shard, pool_id (previous),
+                                    pool_id (interned));
+    }
+    previous = interned;
+  }
+  return NULL;
+}
+
+/**
+ * Add the words and then the bigrams of a shard to the chain
+ * @param shard
+ * @param markov_chain
+ * @param pool
+ * @return 0 on success, 1 in case of allocation error
+ */
+static int merge_shard (const Shard *shard, MarkovChain *markov_chain,
+                        StringPool *pool) {
+  uint32_t words = shard->pool->size;
+  Node **nodes = malloc ((words + 1) * sizeof (Node *));
+  if (nodes == NULL) {
+    return 1;
+  }
+  int result = 0;
+  for (uint32_t id = 0; id < words && !result; ++id) {
+    const char *interned = pool_intern (pool, shard->pool->strings[id]);
+    nodes[id] = interned == NULL ? NULL
+                                 : add_to_database (markov_chain,
+                                                    (gen_data) interned);
+    result = nodes[id] == NULL;
+  }
+  for (uint32_t i = 0; i < shard->bigrams_len && !result; ++i) {
+    const Bigram *bigram = &shard->bigrams[i];
+    result = !add_weighted_to_counter_list (nodes[bigram->first]->data,
+                                            nodes[bigram->second]->data,
+                                            bigram->count, markov_chain);
+  }
+  free (nodes);
+  return result;
+}
+
+/**
+ * Split the text into count shards that end at the end of a line
+ * @param text
+ * @param size
+ * @param shards
+ * @param count
+ */
+static void split_shards (const char *text, size_t size, Shard *shards,
+                          int count) {
+  const char *start = text;
+  const char *end = text + size;
+  for (int i = 0; i < count; ++i) {
+    const char *stop = text + size / count * (i + 1);
+    if (i == count - 1 || stop <= start) {
+      stop = i == count - 1 ? end : start;
+    }
+    else {
+      const char *newline = memchr (stop - 1, '\n', (size_t) (end - stop) + 1);
+      stop = newline == NULL ? end : newline + 1;
+    }
+    shards[i].start = start;
+    shards[i].size = (size_t) (stop - start);
+    start = stop;
+  }
+}
+
+int fill_database_sharded (const char *text, size_t size,
+                           MarkovChain *markov_chain, StringPool *pool) {
+  long count = sysconf (_SC_NPROCESSORS_ONLN);
+  count = count > MAX_SHARDS ? MAX_SHARDS : count;
+  count = count > (long) (size / MIN_SHARD_SIZE) ? (long) (size
+      / MIN_SHARD_SIZE) : count;
+  count = count < 1 ? 1 : count;
+  Shard shards[MAX_SHARDS];
+  pthread_t threads[MAX_SHARDS];
+  int started[MAX_SHARDS] = {0};
+  memset (shards, 0, sizeof (shards));
+  split_shards (text, size, shards, (int) count);
+
+  int result = 0;
+  for (long i = 0; i < count; ++i) {
+    shards[i].is_last = markov_chain->is_last;
+    shards[i].pool = pool_create ();
+    shards[i].result = shards[i].pool == NULL;
+    if (shards[i].pool != NULL) {
+      started[i] = count > 1 && pthread_create (&threads[i], NULL,
+                                                read_shard, &shards[i]) == 0;
+      if (!started[i]) {
+        read_shard (&shards[i]);
+      }
+    }
+  }
+  for (long i = 0; i < count; ++i) {
+    if (started[i]) {
+      pthread_join (threads[i], NULL);
+    }
+    result = result || shards[i].result;
+  }
+
+  // merging in shard order keeps the order of first appearance
+  for (long i = 0; i < count && !result; ++i) {
+    result = merge_shard (&shards[i], markov_chain, pool);
+  }
+  for (long i = 0; i < count; ++i) {
+    pool_destroy (shards[i].pool);
+    free (shards[i].bigrams);
+    free (shards[i].slots);
+  }
+  return result;
+}
@@ -0,0 +1,26 @@
+#ifndef _SHARD_INGEST_H_
+#define _SHARD_INGEST_H_
+
+#include <stddef.h> // For size_t
+#include "markov_chain.h"
+#include "string_pool.h"
+
+#define MAX_SHARDS 16
+
+/**
+ * Fill the database of the chain with the words of the text, the way
+ * tweets_generator reads a file line by line, on several threads.
+ * The text is split into newline-aligned shards. Each thread interns
+ * its words in a local pool and counts its bigrams without locks, then
+ * the shards are merged into the chain in order, so the result is the
+ * same as reading the text on a single thread.
+ * @param text the whole corpus
+ * @param size the length of text
+ * @param markov_chain the chain to fill, its words are interned in pool
+ * @param pool the pool of the chain's words
+ * @return 0 on success, 1 in case of allocation error
+ */
+int fill_database_sharded (const char *text, size_t size,
+                           MarkovChain *markov_chain, StringPool *pool);
+
+#endif //_SHARD_INGEST_H_
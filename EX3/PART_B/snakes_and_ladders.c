@@ -66,6 +66,7 @@ static int snl_comp (gen_data ptr1, gen_data ptr2);
 static void snl_free (gen_data ptr);
 static gen_data snl_cpy (gen_data ptr);
 static bool snl_last (gen_data ptr);
+static size_t snl_hash (gen_data ptr);
 
 // functions
 /**
@@ -136,6 +137,15 @@ static bool snl_last (gen_data ptr) {
   Cell *c1 = (Cell *) ptr;
   return (c1->number == BOARD_SIZE);
 }
+
+/**
+ * Hash function for cell struct data type, the cell number is unique
+ * @param ptr
+ * @return
+ */
+static size_t snl_hash (gen_data ptr) {
+  return (size_t) ((Cell *) ptr)->number;
+}
 //---------------------------------------------------------
 
 /**
@@ -181,6 +191,7 @@ static MarkovChain *create_chain () {
   chain->print_func = snl_print;
   chain->free_data = snl_free;
   chain->is_last = snl_last;
+  chain->hash_func = snl_hash;
   return chain;
 }
 
@@ -309,6 +320,9 @@ int main (int argc, char *argv[]) {
     free_markov_chain (&markov_chain);
     return EXIT_FAILURE;
   }
+  if (!freeze_markov_chain (markov_chain)) {
+    return handle_error (ALLOCATION_ERROR_MESSAGE, &markov_chain);
+  }
   print_path (markov_chain, paths_to_generate);
   free_markov_chain (&markov_chain);
   return EXIT_SUCCESS;
@@ -0,0 +1,151 @@
+#include "string_pool.h"
+#include <stdlib.h> // For malloc(), free()
+#include <string.h> // For strlen(), memcpy()
+
+#define FNV_PRIME 16777619u
+#define MIN_POOL_CAPACITY 1024
+#define POOL_CHUNK_SIZE (1 << 20)
+
+/**
+ * FNV-1a hash of len bytes, continuing from hash (POOL_HASH_SEED for the
+ * first bytes), the hash the pool uses for its strings.
+ * @param hash
+ * @param data
+ * @param len
+ * @return
+ */
+uint32_t pool_hash (uint32_t hash, const void *data, size_t len) {
+  const unsigned char *bytes = data;
+  for (size_t i = 0; i < len; ++i) {
+    hash = (hash ^ bytes[i]) * FNV_PRIME;
+  }
+  return hash;
+}
+
+/**
+ * Find the slot of the first len characters of str in the hash set, or
+ * the empty slot where they belong
+ * @param pool
+ * @param str
+ * @param len
+ * @param hash
+ * @return
+ */
+static uint32_t *find_slot (const StringPool *pool, const char *str,
+                            size_t len, uint32_t hash) {
+  uint32_t mask = pool->slots_capacity - 1;
+  uint32_t i = hash & mask;
+  while (pool->slots[i] != 0 &&
+         (pool->hashes[pool->slots[i] - 1] != hash ||
+          strncmp (pool->strings[pool->slots[i] - 1], str, len) != 0 ||
+          pool->strings[pool->slots[i] - 1][len] != '\0')) {
+    i = (i + 1) & mask;
+  }
+  return &pool->slots[i];
+}
+
+/**
+ * Make room for one more string: grow the id arrays and keep the hash
+ * set at most half full
+ * @param pool
+ * @return 0 on success, 1 in case of allocation error
+ */
+static int reserve_string (StringPool *pool) {
+  if (pool->size == pool->capacity) {
+    uint32_t capacity = 2 * pool->capacity;
+    const char **strings = realloc (pool->strings,
+                                    capacity * sizeof (const char *));
+    if (strings == NULL) {
+      return 1;
+    }
+    pool->strings = strings;
+    uint32_t *hashes = realloc (pool->hashes, capacity * sizeof (uint32_t));
+    if (hashes == NULL) {
+      return 1;
+    }
+    pool->hashes = hashes;
+    pool->capacity = capacity;
+  }
+  if (2 * (pool->size + 1) > pool->slots_capacity) {
+    uint32_t capacity = 2 * pool->slots_capacity;
+    uint32_t *slots = calloc (capacity, sizeof (uint32_t));
+    if (slots == NULL) {
+      return 1;
+    }
+    free (pool->slots);
+    pool->slots = slots;
+    pool->slots_capacity = capacity;
+    for (uint32_t id = 0; id < pool->size; ++id) {
+      *find_slot (pool, pool->strings[id], strlen (pool->strings[id]),
+                  pool->hashes[id]) = id + 1;
+    }
+  }
+  return 0;
+}
+
+StringPool *pool_create (void) {
+  StringPool *pool = calloc (1, sizeof (StringPool));
+  if (pool == NULL) {
+    return NULL;
+  }
+  pool->arena = arena_create (POOL_CHUNK_SIZE);
+  pool->strings = malloc (MIN_POOL_CAPACITY * sizeof (const char *));
+  pool->hashes = malloc (MIN_POOL_CAPACITY * sizeof (uint32_t));
+  pool->slots = calloc (2 * MIN_POOL_CAPACITY, sizeof (uint32_t));
+  pool->capacity = MIN_POOL_CAPACITY;
+  pool->slots_capacity = 2 * MIN_POOL_CAPACITY;
+  if (pool->arena == NULL || pool->strings == NULL || pool->hashes == NULL
+      || pool->slots == NULL) {
+    pool_destroy (pool);
+    return NULL;
+  }
+  return pool;
+}
+
+const char *pool_intern (StringPool *pool, const char *str) {
+  return pool_intern_n (pool, str, strlen (str));
+}
+
+/**
+ * Every string is stored right after its id, so the id of an interned
+ * string can be read back from its pointer.
+ */
+const char *pool_intern_n (StringPool *pool, const char *str, size_t len) {
+  uint32_t hash = pool_hash (POOL_HASH_SEED, str, len);
+  uint32_t *slot = find_slot (pool, str, len, hash);
+  if (*slot != 0) {
+    return pool->strings[*slot - 1];
+  }
+  if (pool->size == POOL_INVALID_ID - 1 || reserve_string (pool)) {
+    return NULL;
+  }
+  char *stored = arena_alloc_bytes (pool->arena, sizeof (uint32_t) + len + 1);
+  if (stored == NULL) {
+    return NULL;
+  }
+  uint32_t id = pool->size++;
+  memcpy (stored, &id, sizeof (uint32_t));
+  memcpy (stored + sizeof (uint32_t), str, len);
+  stored[sizeof (uint32_t) + len] = '\0';
+  pool->strings[id] = stored + sizeof (uint32_t);
+  pool->hashes[id] = hash;
+  *find_slot (pool, str, len, hash) = id + 1;
+  return pool->strings[id];
+}
+
+uint32_t pool_id (const char *str) {
+  uint32_t id;
+  memcpy (&id, str - sizeof (uint32_t), sizeof (uint32_t));
+  return id;
+}
+
+void pool_destroy (StringPool *pool) {
+  if (pool == NULL) {
+    return;
+  }
+  arena_destroy (pool->arena);
+  free (pool->strings);
+  free (pool->hashes);
+  free (pool->slots);
+  free (pool);
+}
@@ -0,0 +1,77 @@
+#ifndef _STRING_POOL_H_
+#define _STRING_POOL_H_
+
+#include <stddef.h> // For size_t
+#include <stdint.h> // For uint32_t
+#include "arena.h"
+
+#define POOL_INVALID_ID UINT32_MAX
+#define POOL_HASH_SEED 2166136261u
+
+/**
+ * Interned strings: every distinct string is stored once, back to back
+ * in the pool's arena, and has a dense 32-bit id. Interning the same
+ * characters twice returns the same pointer, so interned strings are
+ * equal exactly when their pointers are.
+ */
+typedef struct StringPool {
+    Arena *arena;
+    // strings[id] is the interned string, hashes[id] its hash
+    const char **strings;
+    uint32_t *hashes;
+    uint32_t size;
+    uint32_t capacity;
+    // open addressing hash set of id + 1, 0 for an empty slot
+    uint32_t *slots;
+    uint32_t slots_capacity;
+} StringPool;
+
+/**
+ * FNV-1a hash of len bytes, continuing from hash (POOL_HASH_SEED for the
+ * first bytes), the hash the pool uses for its strings.
+ * @param hash
+ * @param data
+ * @param len
+ * @return
+ */
+uint32_t pool_hash (uint32_t hash, const void *data, size_t len);
+
+/**
+ * Create an empty pool.
+ * @return the pool, NULL in case of allocation error
+ */
+StringPool *pool_create (void);
+
+/**
+ * Intern a string.
+ * @param pool
+ * @param str
+ * @return the interned copy of str, NULL in case of allocation error
+ */
+const char *pool_intern (StringPool *pool, const char *str);
+
+/**
+ * Intern the first len characters of str, which need not be NUL
+ * terminated.
+ * @param pool
+ * @param str
+ * @param len
+ * @return the interned (NUL terminated) copy, NULL in case of allocation
+ * error
+ */
+const char *pool_intern_n (StringPool *pool, const char *str, size_t len);
+
+/**
+ * The id of an interned string.
+ * @param str a string returned by pool_intern
+ * @return
+ */
+uint32_t pool_id (const char *str);
+
+/**
+ * Free the pool and all its strings.
+ * @param pool
+ */
+void pool_destroy (StringPool *pool);
+
+#endif //_STRING_POOL_H_
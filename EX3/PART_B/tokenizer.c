@@ -0,0 +1,168 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "tokenizer.h"
+#include <fcntl.h> // For open()
+#include <sys/mman.h> // For mmap(), munmap()
+#include <sys/stat.h> // For fstat()
+#include <unistd.h> // For close()
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#define BLOCK_SIZE 16
+#define BLOCK_MASK 0xFFFFu
+#endif
+
+/**
+ * Map the whole file with a single mmap.
+ * @param path
+ * @param corpus set to the mapped text (an empty file maps to no text)
+ * @return 0 on success, 1 if the file could not be opened or mapped
+ */
+int map_corpus (const char *path, Corpus *corpus) {
+  *corpus = (Corpus) {NULL, 0, NULL, 0};
+  int fd = open (path, O_RDONLY);
+  if (fd < 0) {
+    return 1;
+  }
+  struct stat info;
+  if (fstat (fd, &info) != 0) {
+    close (fd);
+    return 1;
+  }
+  if (info.st_size > 0) {
+    void *mapping = mmap (NULL, (size_t) info.st_size, PROT_READ,
+                          MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED) {
+      close (fd);
+      return 1;
+    }
+    corpus->mapping = mapping;
+    corpus->mapping_size = (size_t) info.st_size;
+    corpus->text = mapping;
+    corpus->size = (size_t) info.st_size;
+  }
+  close (fd);
+  return 0;
+}
+
+/**
+ * Unmap a corpus
+ * @param corpus
+ */
+void unmap_corpus (Corpus *corpus) {
+  if (corpus->mapping != NULL) {
+    munmap (corpus->mapping, corpus->mapping_size);
+  }
+  *corpus = (Corpus) {NULL, 0, NULL, 0};
+}
+
+/**
+ * Start reading the words of the text. The text starts a line.
+ * @param tokenizer
+ * @param text
+ * @param size the length of text
+ */
+void tokenizer_init (Tokenizer *tokenizer, const char *text, size_t size) {
+  tokenizer->position = text;
+  tokenizer->end = text + size;
+  tokenizer->at_line_start = true;
+}
+
+static bool is_delimiter (char c) {
+  return c == ' ' || c == '\r' || c == '\n';
+}
+
+#ifdef __SSE2__
+/**
+ * Compare a block of the text against the delimiters
+ * @param block BLOCK_SIZE characters, no alignment needed
+ * @param newlines set to the bit mask of the '\n' characters
+ * @return the bit mask of the delimiters
+ */
+static unsigned delimiter_mask (const char *block, unsigned *newlines) {
+  __m128i chars = _mm_loadu_si128 ((const __m128i *) block);
+  __m128i newline = _mm_cmpeq_epi8 (chars, _mm_set1_epi8 ('\n'));
+  __m128i others = _mm_or_si128 (_mm_cmpeq_epi8 (chars, _mm_set1_epi8 (' ')),
+                                 _mm_cmpeq_epi8 (chars,
+                                                 _mm_set1_epi8 ('\r')));
+  *newlines = (unsigned) _mm_movemask_epi8 (newline);
+  return (unsigned) _mm_movemask_epi8 (_mm_or_si128 (newline, others));
+}
+#endif
+
+/**
+ * Skip the delimiters before the next word
+ * @param tokenizer
+ * @param position
+ * @return the first character of the word (or the end of the text)
+ */
+static const char *skip_delimiters (Tokenizer *tokenizer,
+                                    const char *position) {
+  const char *end = tokenizer->end;
+#ifdef __SSE2__
+  while (end - position >= BLOCK_SIZE) {
+    unsigned newlines;
+    unsigned words = ~delimiter_mask (position, &newlines) & BLOCK_MASK;
+    if (words == 0) {
+      tokenizer->at_line_start |= newlines != 0;
+      position += BLOCK_SIZE;
+      continue;
+    }
+    unsigned skip = (unsigned) __builtin_ctz (words);
+    tokenizer->at_line_start |= (newlines & ((1u << skip) - 1)) != 0;
+    return position + skip;
+  }
+#endif
+  while (position < end && is_delimiter (*position)) {
+    tokenizer->at_line_start |= *position == '\n';
+    ++position;
+  }
+  return position;
+}
+
+/**
+ * Find the end of the word
+ * @param tokenizer
+ * @param position the first character of the word
+ * @return the delimiter after the word (or the end of the text)
+ */
+static const char *skip_word (const Tokenizer *tokenizer,
+                              const char *position) {
+  const char *end = tokenizer->end;
+#ifdef __SSE2__
+  while (end - position >= BLOCK_SIZE) {
+    unsigned newlines;
+    unsigned delimiters = delimiter_mask (position, &newlines);
+    if (delimiters != 0) {
+      return position + __builtin_ctz (delimiters);
+    }
+    position += BLOCK_SIZE;
+  }
+#endif
+  while (position < end && !is_delimiter (*position)) {
+    ++position;
+  }
+  return position;
+}
+
+/**
+ * Read the next word of the text, scanning 16 characters at a time
+ * where SSE2 is available.
+ * @param tokenizer
+ * @param token set to the word
+ * @return false once the text has no more words
+ */
+bool next_token (Tokenizer *tokenizer, Token *token) {
+  const char *start = skip_delimiters (tokenizer, tokenizer->position);
+  if (start == tokenizer->end) {
+    tokenizer->position = start;
+    return false;
+  }
+  const char *stop = skip_word (tokenizer, start);
+  token->start = start;
+  token->len = (size_t) (stop - start);
+  token->new_line = tokenizer->at_line_start;
+  tokenizer->position = stop;
+  tokenizer->at_line_start = false;
+  return true;
+}
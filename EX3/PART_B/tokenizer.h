@@ -0,0 +1,67 @@
+#ifndef _TOKENIZER_H_
+#define _TOKENIZER_H_
+
+#include <stdbool.h>
+#include <stddef.h> // For size_t
+
+/**
+ * A corpus file mapped read only into memory
+ */
+typedef struct Corpus {
+    const char *text;
+    size_t size;
+    void *mapping;
+    size_t mapping_size;
+} Corpus;
+
+/**
+ * A word of the text, pointing into it (not NUL terminated)
+ */
+typedef struct Token {
+    const char *start;
+    size_t len;
+    // true if it is the first word of its line
+    bool new_line;
+} Token;
+
+/**
+ * Splits a text into the words between spaces and line breaks
+ */
+typedef struct Tokenizer {
+    const char *position;
+    const char *end;
+    bool at_line_start;
+} Tokenizer;
+
+/**
+ * Map the whole file with a single mmap.
+ * @param path
+ * @param corpus set to the mapped text (an empty file maps to no text)
+ * @return 0 on success, 1 if the file could not be opened or mapped
+ */
+int map_corpus (const char *path, Corpus *corpus);
+
+/**
+ * Unmap a corpus
+ * @param corpus
+ */
+void unmap_corpus (Corpus *corpus);
+
+/**
+ * Start reading the words of the text. The text starts a line.
+ * @param tokenizer
+ * @param text
+ * @param size the length of text
+ */
+void tokenizer_init (Tokenizer *tokenizer, const char *text, size_t size);
+
+/**
+ * Read the next word of the text, scanning 16 characters at a time
+ * where SSE2 is available.
+ * @param tokenizer
+ * @param token set to the word
+ * @return false once the text has no more words
+ */
+bool next_token (Tokenizer *tokenizer, Token *token);
+
+#endif //_TOKENIZER_H_
@@ -3,18 +3,29 @@
 #include <string.h>
 #include "linked_list.h"
 #include "markov_chain.h"
+#include "string_pool.h"
+#include "shard_ingest.h"
+#include "tokenizer.h"
+#include "markov_model.h"
+#include "context_table.h"
 
 #define ARGSAMOUNT 5
+#define MODEL_ARGSAMOUNT 6
+#define ORDER_ARGSAMOUNT 7
+#define MAX_ORDER 8
+#define NO_MODEL_PATH "-"
 #define BASE 10
 
-#define READMODE "r"
-#define SPACE " \r\n"
 #define FULLSTOP '.'
 #define TWEET "Tweet "
 
 #define OPEN_FILE_ERROR "Error: could not open the file. \n"
+#define INVALID_MODEL_ERROR "Error: the model file is invalid. \n"
+#define SAVE_MODEL_ERROR "Error: could not save the model. \n"
 #define USAGE_ERROR "Usage: the arguments must be: seed, tweets number, " \
-"words to read, path to file and words to read (optional)."
+"path to file or model, words to read (optional, -1 for all), path to " \
+"save the model to (optional, - for none) and order of the chain " \
+"(optional, 1 to 8, only 1 if the model is saved)."
 
 
 //---------------------------------------------------------
@@ -22,9 +33,9 @@
 #include <stdbool.h>
 static void word_print (gen_data ptr);
 static int word_comp (gen_data ptr1, gen_data ptr2);
-static void word_free (gen_data ptr);
 static gen_data word_cpy (gen_data ptr);
 static bool word_last (gen_data ptr);
+static size_t word_hash (gen_data ptr);
 
 /**
  * TODO: write description
@@ -34,31 +45,88 @@ static void word_print (gen_data ptr) {
   printf ("%s ", (char *) ptr);
 }
 
+/**
+ * Words are interned, so equal words are the same string and comparing
+ * their ids is enough
+ * @param ptr1
+ * @param ptr2
+ * @return
+ */
 static int word_comp (gen_data ptr1,
                       gen_data ptr2) {
-  return (strcmp ((char *) ptr1, (char *) ptr2));
-}
-
-static void word_free (gen_data ptr) {
-  free (ptr);
+  uint32_t id1 = pool_id ((const char *) ptr1);
+  uint32_t id2 = pool_id ((const char *) ptr2);
+  return (id1 > id2) - (id1 < id2);
 }
 
+/**
+ * Interned words live as long as the pool, the chain just keeps the
+ * pointer (so it has no free_data)
+ * @param ptr
+ * @return
+ */
 static gen_data word_cpy (gen_data ptr) {
-  char *src = (char *) ptr;
-  char *dest = calloc (1, strlen (src) + 1);
-  if (src == NULL) {
-    free (dest);
-    src = NULL;
-    return NULL;
-  }
-  strcpy(dest, src);
-  return dest;
+  return ptr;
 }
 
 static bool word_last (gen_data ptr) {
   char *word = (char *) ptr;
   return (word[strlen (word) - 1] == '.');
 }
+
+/**
+ * The ids of the interned words are dense, so they hash perfectly
+ * @param ptr
+ * @return
+ */
+static size_t word_hash (gen_data ptr) {
+  return pool_id ((const char *) ptr);
+}
+//---------------------------------------------------------
+
+//---------------------------------------------------------
+// CONTEXT HELPERS (states of a chain of order > 1)
+
+/**
+ * Prints all the words of the context
+ * @param ptr
+ */
+static void context_print (gen_data ptr) {
+  const Context *context = ptr;
+  for (uint32_t i = 0; i < context->order; ++i) {
+    word_print ((gen_data) context->words[i]);
+  }
+}
+
+/**
+ * Prints the word the context adds after the previous one
+ * @param ptr
+ */
+static void context_print_last (gen_data ptr) {
+  const Context *context = ptr;
+  word_print ((gen_data) context->words[context->order - 1]);
+}
+
+/**
+ * Contexts are interned, so comparing their ids is enough
+ * @param ptr1
+ * @param ptr2
+ * @return
+ */
+static int context_comp (gen_data ptr1, gen_data ptr2) {
+  uint32_t id1 = ((const Context *) ptr1)->id;
+  uint32_t id2 = ((const Context *) ptr2)->id;
+  return (id1 > id2) - (id1 < id2);
+}
+
+static bool context_last (gen_data ptr) {
+  const Context *context = ptr;
+  return word_last ((gen_data) context->words[context->order - 1]);
+}
+
+static size_t context_hash (gen_data ptr) {
+  return ((const Context *) ptr)->id;
+}
 //---------------------------------------------------------
 
 
@@ -79,13 +147,27 @@ static void print_tweet (MarkovChain *markov_chain, int count) {
   }
 }
 
+/**
+ * Function that prints tweets from a saved model
+ * @param model: the mapped model
+ * @param count: amount of tweets that needs to be created
+ */
+static void print_model_tweets (const MarkovModel *model, int count) {
+  for (int tnum = 0; tnum < count; tnum++) {
+    printf (TWEET);
+    printf ("%d: ", tnum + 1);
+    generate_model_sequence (model, word_print, MAXWORDLEN);
+    printf ("\n");
+  }
+}
+
 /**
  * Function that checks if the amount of the arguments given is correct
  * @param arg: argc of the program
- * @return:  1 if the arguments amount is wrong, 0 if 4 or 5
+ * @return:  1 if the arguments amount is wrong, 0 if 4 to 7
  */
 static int check_args (int arg) {
-  if (arg != ARGSAMOUNT - 1 && arg != ARGSAMOUNT) {
+  if (arg < ARGSAMOUNT - 1 || arg > ORDER_ARGSAMOUNT) {
     fprintf (stdout, USAGE_ERROR);
     return FAILURE;
   }
@@ -100,7 +182,7 @@ static int check_args (int arg) {
  */
 static size_t get_words_to_read (int arg1, char *arg2) {
   size_t r;
-  if (arg1 == ARGSAMOUNT) {
+  if (arg1 >= ARGSAMOUNT) {
     r = (size_t) strtol (arg2, NULL, BASE);
   }
   if (arg1 == ARGSAMOUNT - 1) {
@@ -109,6 +191,40 @@ static size_t get_words_to_read (int arg1, char *arg2) {
   return r;
 }
 
+/**
+ * Function that reads the path to save the model to
+ * @param arg1: argc
+ * @param arg2: argv[]
+ * @return: the path, NULL if not given or NO_MODEL_PATH
+ */
+static const char *get_model_path (int arg1, char *arg2) {
+  if (arg1 < MODEL_ARGSAMOUNT || strcmp (arg2, NO_MODEL_PATH) == 0) {
+    return NULL;
+  }
+  return arg2;
+}
+
+/**
+ * Function that reads the order of the chain
+ * @param arg1: argc
+ * @param arg2: argv[]
+ * @param model_path: the path to save the model to, NULL if none
+ * @return: 1 if not given, the order if given, 0 if it is not in
+ * [1, MAX_ORDER] or above 1 while the model is saved (only chains of
+ * order 1 can be saved, so this is rejected before training)
+ */
+static int get_order (int arg1, char *arg2, const char *model_path) {
+  if (arg1 < ORDER_ARGSAMOUNT) {
+    return 1;
+  }
+  long order = strtol (arg2, NULL, BASE);
+  if (order < 1 || order > MAX_ORDER || (order > 1 && model_path != NULL)) {
+    fprintf (stdout, USAGE_ERROR);
+    return 0;
+  }
+  return (int) order;
+}
+
 /**
  * Function that instantiates the seed
  * @param arg: the seed parameter from argv[]
@@ -119,17 +235,15 @@ static void create_seed (char *arg) {
 }
 
 /**
- * Function that tries to open the file given
- * @param f: pointer to pointer to file
+ * Function that tries to map the file given
+ * @param corpus: set to the mapped file
  * @param filename: the filename from the argv[]
  * @return: 1 if did not succeed in opening the file, 0 otherwise
  */
-static int open_file (FILE **f, char *filename) {
-  *f = fopen (filename, READMODE);
-  if (*f == NULL) // if did not succeed
+static int open_file (Corpus *corpus, char *filename) {
+  if (map_corpus (filename, corpus) != SUCCESS) // if did not succeed
   {
     fprintf (stdout, OPEN_FILE_ERROR);  // print error and exit
-    fclose (*f);
     return FAILURE;
   }
   return SUCCESS;
@@ -138,9 +252,10 @@ static int open_file (FILE **f, char *filename) {
 /**
  * Function that creates empty Markov chain and instantiates the database
  * field
+ * @param order: amount of words in a state
  * @return: the created Markov chain
  */
-static MarkovChain *create_chain () {
+static MarkovChain *create_chain (int order) {
   MarkovChain *chain = calloc (1, sizeof (struct MarkovChain));
   if (chain == NULL) {
     fprintf (stdout, ALLOCATION_ERROR_MESSAGE);
@@ -155,71 +270,138 @@ static MarkovChain *create_chain () {
     list = NULL;
     return NULL;
   }
+  chain->arena = arena_create (ARENA_CHUNK_SIZE);
+  if (chain->arena == NULL) {
+    fprintf (stdout, ALLOCATION_ERROR_MESSAGE);
+    free (list);
+    free (chain);
+    return NULL;
+  }
   chain->database = list;
   chain->copy_func = word_cpy;
-  chain->comp_func = word_comp;
-  chain->print_func = word_print;
-  chain->free_data = word_free;
-  chain->is_last = word_last;
+  chain->comp_func = order > 1 ? context_comp : word_comp;
+  chain->print_func = order > 1 ? context_print : word_print;
+  chain->free_data = NULL;
+  chain->is_last = order > 1 ? context_last : word_last;
+  chain->hash_func = order > 1 ? context_hash : word_hash;
+  chain->order = order;
+  chain->print_step_func = order > 1 ? context_print_last : NULL;
   return chain;
 }
 
+/**
+ * Function that adds the state made of the last words read to the
+ * database: the word itself, or their context if the order is above 1
+ * @param markov_chain: the Markov chain
+ * @param contexts: the table the contexts are interned in (order > 1)
+ * @param words: the last order words read, interned
+ * @return: the node of the state, NULL in case of allocation error
+ */
+static Node *add_state (MarkovChain *markov_chain, ContextTable *contexts,
+                        const char *const *words) {
+  gen_data state = (gen_data) words[0];
+  if (contexts != NULL) {
+    state = (gen_data) context_intern (contexts, words);
+  }
+  Node *node = state == NULL ? NULL : add_to_database (markov_chain, state);
+  if (node == NULL) {
+    fprintf (stdout, ALLOCATION_ERROR_MESSAGE);
+  }
+  return node;
+}
+
 /**
  * Function that fill the database (Linked List) with the words from the
- * file given
- * @param fp: pointer to file from which the words are read
+ * file given. A state is the last order words read, and it follows the
+ * previous state unless a line or a sentence ended in between.
+ * @param corpus: the mapped file from which the words are read
  * @param words_to_read: amount of words to read (-1 if all, exact number if
  * it is given)
  * @param markov_chain: instantiated Markov chain to which the data is saved
+ * @param pool: the pool the words are interned in
+ * @param contexts: the table the states are interned in (order > 1)
  * @return: 1 if did not succeed, 0 otherwise
  */
-static int fill_database (FILE *fp, int words_to_read, MarkovChain
-*markov_chain) {
-  char input[MAXSENTENCELEN + 1] = {0};
-  char *word = NULL, *next = NULL;
-  Node *node1 = NULL, *node2 = NULL;
+static int fill_database (const Corpus *corpus, int words_to_read,
+                          MarkovChain *markov_chain, StringPool *pool,
+                          ContextTable *contexts) {
+  int order = contexts != NULL ? contexts->order : 1;
+  const char *window[MAX_ORDER] = {NULL};
+  int window_len = 0;
+  Tokenizer tokenizer;
+  Token token;
+  Node *previous = NULL;
   int words_read = 0;
-  while (fgets (input, MAXSENTENCELEN + 1, fp) != NULL) {
-    word = strtok (input, SPACE);
+  tokenizer_init (&tokenizer, corpus->text, corpus->size);
+  while (words_read != words_to_read && next_token (&tokenizer, &token)) {
     ++words_read;
-    while (word != NULL) {
-      node1 = add_to_database (markov_chain, word);
-      if (node1 == NULL) {
-        free_markov_chain (&markov_chain);
-        return FAILURE;
-      }
-      if (words_read == words_to_read) {
-        return SUCCESS;
-      }
-      next = strtok (NULL, SPACE);
-      ++words_read;
-      if (next != NULL) {
-        node2 = add_to_database (markov_chain, next);
-        if (node2 == NULL) {
-          free_markov_chain (&markov_chain);
-          return FAILURE;
-        }
-        if (!markov_chain->is_last (node1->data->data)) {
-          add_node_to_counter_list (node1->data,
-                                    node2->data,
-                                    markov_chain);
-        }
-        word = next;
-        if (words_read == words_to_read) {
-          return SUCCESS;
-        }
-      }
-      else {
-        if (words_read == words_to_read) {
-          return SUCCESS;
-        }
-        word = next;
-      }
+    const char *word = pool_intern_n (pool, token.start, token.len);
+    if (word == NULL) {
+      fprintf (stdout, ALLOCATION_ERROR_MESSAGE);
+      return FAILURE;
+    }
+    if (token.new_line || (window_len > 0
+                           && word_last ((gen_data) window[window_len - 1]))) {
+      window_len = 0;
+      previous = NULL;
+    }
+    if (window_len == order) {
+      memmove (window, window + 1, (order - 1) * sizeof (const char *));
+      --window_len;
+    }
+    window[window_len++] = word;
+    if (window_len < order) {
+      continue;
+    }
+    Node *node = add_state (markov_chain, contexts, window);
+    if (node == NULL) {
+      return FAILURE;
+    }
+    if (previous != NULL && !add_node_to_counter_list (previous->data,
+                                                       node->data,
+                                                       markov_chain)) {
+      fprintf (stdout, ALLOCATION_ERROR_MESSAGE);
+      return FAILURE;
     }
+    previous = node;
   }
   return SUCCESS;
 }
 
+/**
+ * Function that fills the database with the whole file on several
+ * threads (see fill_database_sharded)
+ * @param corpus: the mapped file from which the words are read
+ * @param markov_chain: instantiated Markov chain to which the data is saved
+ * @param pool: the pool the words are interned in
+ * @return: 1 if did not succeed, 0 otherwise
+ */
+static int fill_database_parallel (const Corpus *corpus,
+                                   MarkovChain *markov_chain,
+                                   StringPool *pool) {
+  int result = fill_database_sharded (corpus->text, corpus->size,
+                                      markov_chain, pool);
+  if (result == FAILURE) {
+    fprintf (stdout, ALLOCATION_ERROR_MESSAGE);
+  }
+  return result;
+}
+
+/**
+ * Function that frees the chain and everything its states point into
+ * @param markov_chain: the Markov chain
+ * @param pool: the pool the words are interned in
+ * @param contexts: the table the contexts are interned in, may be NULL
+ * @param corpus: the mapped file
+ */
+static void free_training (MarkovChain **markov_chain, StringPool *pool,
+                           ContextTable *contexts, Corpus *corpus) {
+  free_markov_chain (markov_chain);
+  context_table_destroy (contexts);
+  pool_destroy (pool);
+  unmap_corpus (corpus);
+}
+
 /**
  * Main function: reads the arguments, checks them for validity, opens the
  * file, instantiates the database and saves it into Markov chain and then
@@ -236,29 +418,60 @@ int main (int argc, char *argv[]) {
   // get the amount of words to read
   size_t words_to_read = get_words_to_read (argc,
                                             argv[ARGSAMOUNT - 1]);
+  const char *model_path = get_model_path (argc, argv[MODEL_ARGSAMOUNT - 1]);
+  int order = get_order (argc, argv[ORDER_ARGSAMOUNT - 1], model_path);
+  if (order == 0) {
+    return EXIT_FAILURE;
+  }
   create_seed (argv[1]);
-  FILE *f = NULL;
-  if (open_file (&f, argv[3]) == FAILURE) // try to open the file
+  int count = (int) strtol (argv[2], NULL, BASE);
+  // a saved model is used as it is, without training
+  MarkovModel model;
+  int opened = open_markov_model (argv[3], &model);
+  if (opened == MODEL_OK) {
+    print_model_tweets (&model, count);
+    close_markov_model (&model);
+    return EXIT_SUCCESS;
+  }
+  if (opened == MODEL_INVALID) {
+    fprintf (stdout, INVALID_MODEL_ERROR);
+    return EXIT_FAILURE;
+  }
+  Corpus corpus;
+  if (open_file (&corpus, argv[3]) == FAILURE) // try to open the file
   {
-    fclose (f);
     return EXIT_FAILURE;
   }
-  MarkovChain *markov_chain = create_chain ();
-  if (markov_chain == NULL) {
-    free_markov_chain (&markov_chain);
-    fclose (f);
+  MarkovChain *markov_chain = create_chain (order);
+  StringPool *pool = pool_create ();
+  ContextTable *contexts = order > 1 ? context_table_create (order) : NULL;
+  if (markov_chain == NULL || pool == NULL || (order > 1 && contexts == NULL)) {
+    fprintf (stdout, ALLOCATION_ERROR_MESSAGE);
+    free_training (&markov_chain, pool, contexts, &corpus);
     return EXIT_FAILURE;
   }
-  if (fill_database (f,
-                     (int) words_to_read, markov_chain) == FAILURE) {
-    free_markov_chain (&markov_chain);
-    fclose (f);
+  // only a limited amount of words, or states of several words, have to
+  // be read in order
+  int filled = (int) words_to_read >= 0 || order > 1
+               ? fill_database (&corpus, (int) words_to_read, markov_chain,
+                                pool, contexts)
+               : fill_database_parallel (&corpus, markov_chain, pool);
+  if (filled == FAILURE) {
+    free_training (&markov_chain, pool, contexts, &corpus);
+    return EXIT_FAILURE;
+  }
+  if (!freeze_markov_chain (markov_chain)) {
+    fprintf (stdout, ALLOCATION_ERROR_MESSAGE);
+    free_training (&markov_chain, pool, contexts, &corpus);
+    return EXIT_FAILURE;
+  }
+  if (model_path != NULL
+      && save_markov_model (model_path, markov_chain) != SUCCESS) {
+    fprintf (stdout, SAVE_MODEL_ERROR);
+    free_training (&markov_chain, pool, contexts, &corpus);
     return EXIT_FAILURE;
   }
-  int count = (int) strtol (argv[2], NULL, BASE);
   print_tweet (markov_chain, count);
-  free_markov_chain (&markov_chain);
-  fclose (f);
+  free_training (&markov_chain, pool, contexts, &corpus);
   return EXIT_SUCCESS;
 }
-